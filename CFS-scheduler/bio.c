@@ -7,12 +7,17 @@
 //
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
-// * After changing buffer data, call bwrite to write it to disk.
+// * After changing buffer data, call bwrite to write it to disk,
+//     or bwritev to write several, so adjacent blocks coalesce.
+// * To overwrite a whole block without reading it, call getblk.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
 //
+// Blocks are bsize bytes: one sector until the file system is
+// mounted, then what its super block says (see bsetsize).
+//
 // The implementation uses two state flags internally:
 // * B_VALID: the buffer data has been read from the disk.
 // * B_DIRTY: the buffer data has been modified
@@ -35,6 +40,8 @@ struct {
   struct buf head;
 } bcache;
 
+uint bsize = MINBSIZE;
+
 void
 binit(void)
 {
@@ -55,6 +62,27 @@ binit(void)
   }
 }
 
+// Switch to blocks of size bytes, when mounting a file system.
+// No buffer may be in use; cached blocks of the old size are
+// dropped.
+void
+bsetsize(uint size)
+{
+  struct buf *b;
+
+  if(size < MINBSIZE || size > MAXBSIZE || (size & (size-1)) != 0)
+    panic("bsetsize: bad size");
+
+  acquire(&bcache.lock);
+  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+    if(b->refcnt != 0 || (b->flags & B_DIRTY))
+      panic("bsetsize: busy");
+    b->flags = 0;
+  }
+  bsize = size;
+  release(&bcache.lock);
+}
+
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
 // In either case, return locked buffer.
@@ -92,6 +120,19 @@ bget(uint dev, uint blockno)
   panic("bget: no buffers");
 }
 
+// Return a locked buf for a block the caller will overwrite
+// entirely: unlike bread, the old contents are not read, and
+// what the caller puts there counts as the block's contents.
+struct buf*
+getblk(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  b->flags |= B_VALID;
+  return b;
+}
+
 // Return a locked buf with the contents of the indicated block.
 struct buf*
 bread(uint dev, uint blockno)
@@ -115,6 +156,21 @@ bwrite(struct buf *b)
   iderw(b);
 }
 
+// Write the contents of n locked bufs to disk, in the order
+// given: sort them by block to coalesce adjacent writes.
+void
+bwritev(struct buf **bs, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&bs[i]->lock))
+      panic("bwritev");
+    bs[i]->flags |= B_DIRTY;
+  }
+  idewritev(bs, n);
+}
+
 // Release a locked buffer.
 // Move to the head of the MRU list.
 void
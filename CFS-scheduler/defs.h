@@ -2,6 +2,7 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct kmem_cache;
 struct pipe;
 struct proc;
 struct rtcdate;
@@ -9,6 +10,8 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct work;
+struct workqueue;
 
 // rbtree.h
 struct rb_root;
@@ -16,13 +19,19 @@ struct rb_node;
 // sched.h
 struct load_weight;
 struct cfs_rq;
+struct rq;
 struct sched_entity;
+struct task_group;
 
 // bio.c
+extern uint     bsize;
 void            binit(void);
+void            bsetsize(uint);
 struct buf*     bread(uint, uint);
+struct buf*     getblk(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bwritev(struct buf**, int);
 
 // console.c
 void            consoleinit(void);
@@ -40,6 +49,7 @@ struct file*    filedup(struct file*);
 void            fileinit(void);
 int             fileread(struct file*, char*, int n);
 int             filestat(struct file*, struct stat*);
+int             filesync(struct file*);
 int             filewrite(struct file*, char*, int n);
 
 // fs.c
@@ -48,8 +58,10 @@ int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+void            icacheinit(void);
 void            iinit(int dev);
 void            ilock(struct inode*);
+void            ilockshared(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
 void            iunlockput(struct inode*);
@@ -65,9 +77,11 @@ int             writei(struct inode*, char*, uint, uint);
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+void            idewritev(struct buf**, int);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
+int             ioapicroute(int irq, int cpu);
 extern uchar    ioapicid;
 void            ioapicinit(void);
 
@@ -92,8 +106,13 @@ void            microdelay(int);
 // log.c
 void            initlog(int dev);
 void            log_write(struct buf*);
+void            log_ordered(struct buf*);
+void            log_free(uint);
+int             log_freed(uint);
+void            log_nospace(void);
 void            begin_op();
 void            end_op();
+void            log_sync(void);
 
 // mp.c
 extern int      ismp;
@@ -104,6 +123,7 @@ void            picenable(int);
 void            picinit(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, char*, int);
@@ -113,8 +133,10 @@ int             pipewrite(struct pipe*, char*, int);
 // proc.c
 int             cpuid(void);
 void            exit(void);
+struct cpu*     findcpu(void);
 int             fork(void);
 int             growproc(int);
+int             kthread_create(void (*)(void*), void*, char*, int);
 int             kill(int);
 struct cpu*     mycpu(void);
 struct proc*    myproc();
@@ -128,27 +150,61 @@ void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
 void            yield(void);
+int             sched_yield(void);
+int             yield_to(int);
 /* ----- My Def -----*/
 void            check_tick(struct proc*, u64);
-struct proc*	  next_proc(struct cfs_rq*);
+struct proc*	  next_proc(struct rq*);
 int             getnice(void);
 int             setnice(int);
 int             forknice(int);
+int             setslice(int);
+int             tgcreate(int);
+int             tgattach(int, int);
+int             tgsetshares(int, int);
+int             tgsetbandwidth(int, int, int);
+void            bwrefill(u64);
+struct tgstat;
+int             tgstat(int, struct tgstat*);
+struct loadavg;
+int             getloadavg(int, struct loadavg*);
+int             sched_setscheduler(int, int, int);
+int             sched_getscheduler(int);
+struct sched_attr;
+int             sched_setattr(int, struct sched_attr*);
+int             sched_setaffinity(int, uint);
+int             sched_getaffinity(int);
+struct sched_tunables;
+int             sched_gettunables(struct sched_tunables*);
+int             sched_settunables(struct sched_tunables*);
 
 // sched.c
 void            init_cfs_rq(struct cfs_rq*);
 void            enqueue_entity_fair(struct cfs_rq*, struct sched_entity*);
 void            dequeue_entity_fair(struct cfs_rq*, struct sched_entity*);
-struct sched_entity* pick_entity_fair(struct cfs_rq*);
+struct sched_entity* pick_entity_fair(struct cfs_rq*, int);
+struct sched_entity* pick_next_entity_fair(struct cfs_rq*, int);
+void            set_curr_entity_fair(struct sched_entity*);
+void            put_curr_entity_fair(struct sched_entity*);
 void			      init_entity(struct sched_entity*);
 void			      copy_entity(struct sched_entity*, struct sched_entity*);
+void            place_new_entity(struct cfs_rq*, struct sched_entity*);
 void            reset_entity(struct sched_entity*, u64);
 int             get_nice_entity(struct sched_entity*);
 void            set_nice_entity(struct sched_entity*, int);
+void            init_task_group(struct task_group*, struct task_group*, struct cfs_rq*);
+void            set_shares_group(struct task_group*, uint);
+void            set_bandwidth_group(struct task_group*, u64, u64, u64);
+void            move_entity_group(struct sched_entity*, struct cfs_rq*, struct task_group*);
 
 // swtch.S
 void            swtch(struct context**, struct context*);
 
+// slab.c
+void            kmem_cache_init(struct kmem_cache*, char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 void            getcallerpcs(void*, uint*);
@@ -160,8 +216,12 @@ void            popcli(void);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
+void            acquiresleepshared(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
+void            releasesleepshared(struct sleeplock*);
+void            downgradesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
+int             holdingsleepshared(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
 // string.c
@@ -182,10 +242,15 @@ int             fetchstr(uint, char**);
 void            syscall(void);
 
 // timer.c
-void            timerinit(void);
+struct timer;
+void            timer_add(struct timer*, u64);
+void            timer_del(struct timer*);
+void            timer_run(u64);
+int             timer_sleep(u64);
 
 // trap.c
 void            idtinit(void);
+void            sysenterinit(void);
 extern uint		ticks;
 extern u64		us;
 void            tvinit(void);
@@ -211,6 +276,17 @@ void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
+struct vdso_data;
+extern struct vdso_data *vdso;
+void            vdsoinit(void);
+int             mapvdso(pde_t*, char*);
+
+// workqueue.c
+void            wqinit(void);
+void            init_workqueue(struct workqueue*, char*, int);
+void            init_work(struct work*, void (*)(struct work*));
+int             queue_work(struct workqueue*, struct work*);
+void            flush_workqueue(struct workqueue*);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
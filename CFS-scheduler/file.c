@@ -5,50 +5,57 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "x86.h"
 #include "fs.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "slab.h"
 
 struct devsw devsw[NDEV];
+
+// Open files come from an object cache, whose per-CPU magazines
+// make most allocations lock-free. The count of open files and
+// each file's ref are updated with atomic instructions, so no
+// table-wide lock is needed.
 struct {
-  struct spinlock lock;
-  struct file file[NFILE];
+  volatile int nfile;         // Number of allocated files
 } ftable;
 
+struct kmem_cache filecache;
+
 void
 fileinit(void)
 {
-  initlock(&ftable.lock, "ftable");
+  kmem_cache_init(&filecache, "file", sizeof(struct file));
 }
 
 // Allocate a file structure.
+// The table grows on demand up to NFILE open files.
 struct file*
 filealloc(void)
 {
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
+  if(xadd(&ftable.nfile, 1) >= NFILE){
+    xadd(&ftable.nfile, -1);
+    return 0;
   }
-  release(&ftable.lock);
-  return 0;
+  if((f = kmem_cache_alloc(&filecache)) == 0){
+    xadd(&ftable.nfile, -1);
+    return 0;
+  }
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
 struct file*
 filedup(struct file *f)
 {
-  acquire(&ftable.lock);
-  if(f->ref < 1)
+  if(xadd(&f->ref, 1) < 1)
     panic("filedup");
-  f->ref++;
-  release(&ftable.lock);
   return f;
 }
 
@@ -57,18 +64,16 @@ void
 fileclose(struct file *f)
 {
   struct file ff;
+  int r;
 
-  acquire(&ftable.lock);
-  if(f->ref < 1)
+  if((r = xadd(&f->ref, -1)) < 1)
     panic("fileclose");
-  if(--f->ref > 0){
-    release(&ftable.lock);
+  if(r > 1)
     return;
-  }
   ff = *f;
-  f->ref = 0;
   f->type = FD_NONE;
-  release(&ftable.lock);
+  kmem_cache_free(&filecache, f);
+  xadd(&ftable.nfile, -1);
 
   if(ff.type == FD_PIPE)
     pipeclose(ff.pipe, ff.writable);
@@ -84,7 +89,7 @@ int
 filestat(struct file *f, struct stat *st)
 {
   if(f->type == FD_INODE){
-    ilock(f->ip);
+    ilockshared(f->ip);
     stati(f->ip, st);
     iunlock(f->ip);
     return 0;
@@ -92,6 +97,17 @@ filestat(struct file *f, struct stat *st)
   return -1;
 }
 
+// Make the changes written to file f durable.
+int
+filesync(struct file *f)
+{
+  if(f->type == FD_INODE){
+    log_sync();
+    return 0;
+  }
+  return -1;
+}
+
 // Read from file f.
 int
 fileread(struct file *f, char *addr, int n)
@@ -103,7 +119,14 @@ fileread(struct file *f, char *addr, int n)
   if(f->type == FD_PIPE)
     return piperead(f->pipe, addr, n);
   if(f->type == FD_INODE){
-    ilock(f->ip);
+    // Only this process can reach an unshared file, so
+    // nobody else can race on f->off: read under a shared
+    // inode lock. A file shared after fork() still needs
+    // the inode lock to serialize the offset update.
+    if(f->ref == 1)
+      ilockshared(f->ip);
+    else
+      ilock(f->ip);
     if((r = readi(f->ip, addr, f->off, n)) > 0)
       f->off += r;
     iunlock(f->ip);
@@ -124,14 +147,14 @@ filewrite(struct file *f, char *addr, int n)
   if(f->type == FD_PIPE)
     return pipewrite(f->pipe, addr, n);
   if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
+    // write at most MAXOPDATA blocks of ordered data at a
+    // time, including 1 block of slop for non-aligned writes;
+    // the i-node, indirect block and allocation blocks fit
+    // easily in the MAXOPBLOCKS that are logged.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
-    int i = 0;
+    int max = (MAXOPDATA-1) * bsize;
+    int i = 0, retried = 0;
     while(i < n){
       int n1 = n - i;
       if(n1 > max)
@@ -146,9 +169,17 @@ filewrite(struct file *f, char *addr, int n)
 
       if(r < 0)
         break;
-      if(r != n1)
-        panic("short filewrite");
       i += r;
+      if(r != n1){
+        // Out of disk space, perhaps only until the blocks freed
+        // by the open transaction are committed: wait for that
+        // and try once more.
+        if(retried)
+          break;
+        log_sync();
+        retried = 1;
+      } else
+        retried = 0;
     }
     return i == n ? n : -1;
   }
@@ -14,6 +14,10 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *next; // hash chain, protected by its bucket lock
+  struct inode *prev;
+  struct inode *lrunext; // unreferenced inodes, protected by icache.lock
+  struct inode *lruprev;
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
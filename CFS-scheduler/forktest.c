@@ -5,7 +5,7 @@
 #include "stat.h"
 #include "user.h"
 
-#define N 1000
+#define N 5000  // more than NPROC
 #define N_CHILD 5
 #define N_WORK 1000000
 
@@ -21,60 +21,76 @@
 #include "buf.h"
 #include "file.h"
 #include "macro.h"
+#include "slab.h"
 
 static void itrunc(struct inode*);
 // there should be one superblock per disk device, but we run with
 // only one device
 struct superblock sb; 
 
-// Read the super block.
+// Read the super block, at byte SBOFF whatever the block size.
 void
 readsb(int dev, struct superblock *sb)
 {
   struct buf *bp;
 
-  bp = bread(dev, 1);
-  memmove(sb, bp->data, sizeof(*sb));
+  bp = bread(dev, SBOFF / bsize);
+  memmove(sb, bp->data + SBOFF % bsize, sizeof(*sb));
   brelse(bp);
 }
 
-// Zero a block.
+// Zero a block: file data is ordered, anything else logged.
 static void
-bzero(int dev, int bno)
+bzero(int dev, int bno, int data)
 {
   struct buf *bp;
 
-  bp = bread(dev, bno);
-  memset(bp->data, 0, BSIZE);
-  log_write(bp);
+  bp = getblk(dev, bno);
+  memset(bp->data, 0, sb.bsize);
+  if(data)
+    log_ordered(bp);
+  else
+    log_write(bp);
   brelse(bp);
 }
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// Allocate a zeroed disk block, to hold file data if data is set.
+// Blocks freed by the open transaction are passed over.
+// Returns 0 if the disk is full; if it is full only until the open
+// transaction commits, a commit is started so a retry can succeed.
 static uint
-balloc(uint dev)
+balloc(uint dev, int data)
 {
-  int b, bi, m;
+  int b, bi, m, freed;
   struct buf *bp;
 
   bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
+  freed = 0;
+  for(b = 0; b < sb.size; b += BPB(sb)){
     bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
+    for(bi = 0; bi < BPB(sb) && b + bi < sb.size; bi++){
       m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
-        brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
+      if((bp->data[bi/8] & m) != 0)
+        continue;
+      if(log_freed(b + bi)){
+        freed = 1;
+        continue;
       }
+      bp->data[bi/8] |= m;  // Mark block in use.
+      log_write(bp);
+      brelse(bp);
+      bzero(dev, b + bi, data);
+      return b + bi;
     }
     brelse(bp);
   }
-  panic("balloc: out of blocks");
+  if(freed)
+    log_nospace();
+  else
+    cprintf("balloc: out of blocks\n");
+  return 0;
 }
 
 // Free a disk block.
@@ -85,13 +101,14 @@ bfree(int dev, uint b)
   int bi, m;
 
   bp = bread(dev, BBLOCK(b, sb));
-  bi = b % BPB;
+  bi = b % BPB(sb);
   m = 1 << (bi % 8);
   if((bp->data[bi/8] & m) == 0)
     panic("freeing free block");
   bp->data[bi/8] &= ~m;
   log_write(bp);
   brelse(bp);
+  log_free(b);
 }
 
 // Inodes.
@@ -116,25 +133,30 @@ bfree(int dev, uint b)
 // rest of the file system code.
 //
 // * Allocation: an inode is allocated if its type (on disk)
-//   is non-zero. ialloc() allocates, and iput() frees if
-//   the reference and link counts have fallen to zero.
+//   is non-zero, and its bit in the inode map is set.
+//   ialloc() allocates, and iput() frees if the reference
+//   and link counts have fallen to zero.
 //
-// * Referencing in cache: an entry in the inode cache
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
-//   creates a cache entry and increments its ref; iput()
-//   decrements ref.
+// * Referencing in cache: ip->ref tracks the number of
+//   in-memory pointers to the entry (open files and current
+//   directories). iget() finds or creates a cache entry and
+//   increments its ref; iput() decrements ref. An entry
+//   whose ref falls to zero stays cached on an LRU list, so
+//   a later iget() finds it still valid; only the NIUNUSED
+//   most recently used of these are kept. Entries come
+//   from an object cache, so the number of referenced
+//   inodes is bounded only by memory.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   cache entry is only correct when ip->valid is 1.
 //   ilock() reads the inode from
 //   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   ip->valid when it frees the inode on disk.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
-//   has first locked the inode.
+//   has first locked the inode. ilockshared() locks it for
+//   examination only, so many readers can proceed at once.
 //
 // Thus a typical sequence is:
 //   ip = iget(dev, inum)
@@ -154,39 +176,133 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The icache.lock spin-lock protects the allocation of icache
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold icache.lock while using any of those fields.
+// Entries are hashed on dev and inum. Each bucket's spin-lock
+// protects the allocation of its entries: since ip->ref indicates
+// whether an entry is in use, and ip->dev and ip->inum indicate
+// which i-node an entry holds, one must hold the bucket lock
+// while using any of those fields. icache.lock protects the LRU
+// list and is taken inside a bucket lock, never the other way.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NIHASH 128
+#define IHASH(dev, inum) (((dev) * 31 + (inum)) % NIHASH)
+#define NIUNUSED 256  // unreferenced inodes kept cached
+
+struct ibucket {
+  struct spinlock lock;
+  struct inode *head;
+};
+
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *lruhead;      // unreferenced inodes, most recent first
+  struct inode *lrutail;
+  int nunused;                // inodes on the LRU list
+  struct ibucket bucket[NIHASH];
 } icache;
 
+struct kmem_cache inodecache;
+
 void
-iinit(int dev)
+icacheinit(void)
 {
-  int i = 0;
-  
+  int i;
+
   initlock(&icache.lock, "icache");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
+  for(i = 0; i < NIHASH; i++)
+    initlock(&icache.bucket[i].lock, "icache bucket");
+  kmem_cache_init(&inodecache, "inode", sizeof(struct inode));
+}
+
+// Take ip off the LRU list. Caller holds its bucket lock.
+static void
+lru_remove(struct inode *ip)
+{
+  acquire(&icache.lock);
+  if(ip->lruprev)
+    ip->lruprev->lrunext = ip->lrunext;
+  else
+    icache.lruhead = ip->lrunext;
+  if(ip->lrunext)
+    ip->lrunext->lruprev = ip->lruprev;
+  else
+    icache.lrutail = ip->lruprev;
+  ip->lrunext = ip->lruprev = 0;
+  icache.nunused--;
+  release(&icache.lock);
+}
+
+// Unhash ip. Caller holds its bucket lock.
+static void
+ihash_remove(struct ibucket *bk, struct inode *ip)
+{
+  if(ip->prev)
+    ip->prev->next = ip->next;
+  else
+    bk->head = ip->next;
+  if(ip->next)
+    ip->next->prev = ip->prev;
+}
+
+// Free least recently used inodes until NIUNUSED are left.
+// The victim is found under icache.lock but freed under its
+// bucket lock, which must come first: so it is looked up again
+// by number, and skipped if it was reused in between.
+static void
+lru_trim(void)
+{
+  struct ibucket *bk;
+  struct inode *ip;
+  uint dev, inum;
+
+  for(;;){
+    acquire(&icache.lock);
+    if(icache.nunused <= NIUNUSED || (ip = icache.lrutail) == 0){
+      release(&icache.lock);
+      return;
+    }
+    dev = ip->dev;
+    inum = ip->inum;
+    release(&icache.lock);
+
+    bk = &icache.bucket[IHASH(dev, inum)];
+    acquire(&bk->lock);
+    for(ip = bk->head; ip; ip = ip->next)
+      if(ip->dev == dev && ip->inum == inum)
+        break;
+    if(ip && ip->ref == 0){
+      lru_remove(ip);
+      ihash_remove(bk, ip);
+    } else
+      ip = 0;
+    release(&bk->lock);
+    if(ip)
+      kmem_cache_free(&inodecache, ip);
   }
+}
 
+void
+iinit(int dev)
+{
   readsb(dev, &sb);
+  bsetsize(sb.bsize);
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
- inodestart %d bmap start %d\n", sb.size, sb.nblocks,
-          sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
-          sb.bmapstart);
+ inodestart %d imap start %d bmap start %d bsize %d\n", sb.size,
+          sb.nblocks, sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
+          sb.imapstart, sb.bmapstart, sb.bsize);
 }
 
 static struct inode* iget(uint dev, uint inum);
 
+// Where the next search of the inode map starts: just past the
+// last inode allocated, so a run of creates does not rescan the
+// same full blocks. It is only a hint, and races on it are
+// harmless.
+static uint irotor = 1;
+
 //PAGEBREAK!
 // Allocate an inode on device dev.
 // Mark it as allocated by  giving it type type.
@@ -194,23 +310,59 @@ static struct inode* iget(uint dev, uint inum);
 struct inode*
 ialloc(uint dev, short type)
 {
-  int inum;
+  uint i, inum, bi, m;
   struct buf *bp;
   struct dinode *dip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
-    bp = bread(dev, IBLOCK(inum, sb));
-    dip = (struct dinode*)bp->data + inum%IPB;
-    if(dip->type == 0){  // a free inode
-      memset(dip, 0, sizeof(*dip));
-      dip->type = type;
-      log_write(bp);   // mark it allocated on the disk
-      brelse(bp);
-      return iget(dev, inum);
+  // Find and claim a clear bit in the inode map.
+  bp = 0;
+  inum = irotor;
+  for(i = 0; i < sb.ninodes; i++, inum++){
+    if(inum >= sb.ninodes)
+      inum = 1;  // inode 0 is never used
+    if(bp == 0 || bp->blockno != IMBLOCK(inum, sb)){
+      if(bp)
+        brelse(bp);
+      bp = bread(dev, IMBLOCK(inum, sb));
     }
-    brelse(bp);
+    bi = inum % BPB(sb);
+    m = 1 << (bi % 8);
+    if((bp->data[bi/8] & m) == 0)
+      break;
   }
-  panic("ialloc: no inodes");
+  if(i == sb.ninodes)
+    panic("ialloc: no inodes");
+  bp->data[bi/8] |= m;
+  log_write(bp);
+  brelse(bp);
+  irotor = inum + 1;
+
+  bp = bread(dev, IBLOCK(inum, sb));
+  dip = (struct dinode*)bp->data + inum%IPB(sb);
+  if(dip->type != 0)
+    panic("ialloc: inode in use");
+  memset(dip, 0, sizeof(*dip));
+  dip->type = type;
+  log_write(bp);   // mark it allocated on the disk
+  brelse(bp);
+  return iget(dev, inum);
+}
+
+// Clear inum's bit in the inode map.
+static void
+ifree(uint dev, uint inum)
+{
+  struct buf *bp;
+  uint bi, m;
+
+  bp = bread(dev, IMBLOCK(inum, sb));
+  bi = inum % BPB(sb);
+  m = 1 << (bi % 8);
+  if((bp->data[bi/8] & m) == 0)
+    panic("freeing free inode");
+  bp->data[bi/8] &= ~m;
+  log_write(bp);
+  brelse(bp);
 }
 
 // Copy a modified in-memory inode to disk.
@@ -224,7 +376,7 @@ iupdate(struct inode *ip)
   struct dinode *dip;
 
   bp = bread(ip->dev, IBLOCK(ip->inum, sb));
-  dip = (struct dinode*)bp->data + ip->inum%IPB;
+  dip = (struct dinode*)bp->data + ip->inum%IPB(sb);
   dip->type = ip->type;
   dip->major = ip->major;
   dip->minor = ip->minor;
@@ -241,32 +393,37 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct ibucket *bk = &icache.bucket[IHASH(dev, inum)];
+  struct inode *ip;
 
-  acquire(&icache.lock);
+  acquire(&bk->lock);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
-      release(&icache.lock);
+  for(ip = bk->head; ip; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
+      if(ip->ref++ == 0)
+        lru_remove(ip);
+      release(&bk->lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
+  // Allocate a new inode cache entry.
+  if((ip = kmem_cache_alloc(&inodecache)) == 0)
     panic("iget: no inodes");
 
-  ip = empty;
+  initsleeplock(&ip->lock, "inode");
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
-  release(&icache.lock);
+  ip->lrunext = ip->lruprev = 0;
+  ip->prev = 0;
+  ip->next = bk->head;
+  if(bk->head)
+    bk->head->prev = ip;
+  bk->head = ip;
+  release(&bk->lock);
 
   return ip;
 }
@@ -276,28 +433,25 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&icache.lock);
+  struct ibucket *bk = &icache.bucket[IHASH(ip->dev, ip->inum)];
+
+  acquire(&bk->lock);
   ip->ref++;
-  release(&icache.lock);
+  release(&bk->lock);
   return ip;
 }
 
-// Lock the given inode.
-// Reads the inode from disk if necessary.
-void
-ilock(struct inode *ip)
+// Read the on-disk inode into ip if it is not cached yet.
+// Caller must hold ip->lock exclusively.
+static void
+ifill(struct inode *ip)
 {
   struct buf *bp;
   struct dinode *dip;
 
-  if(ip == 0 || ip->ref < 1)
-    panic("ilock");
-
-  acquiresleep(&ip->lock);
-
   if(ip->valid == 0){
     bp = bread(ip->dev, IBLOCK(ip->inum, sb));
-    dip = (struct dinode*)bp->data + ip->inum%IPB;
+    dip = (struct dinode*)bp->data + ip->inum%IPB(sb);
     ip->type = dip->type;
     ip->major = dip->major;
     ip->minor = dip->minor;
@@ -311,44 +465,108 @@ ilock(struct inode *ip)
   }
 }
 
-// Unlock the given inode.
+// Lock the given inode.
+// Reads the inode from disk if necessary.
+void
+ilock(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilock");
+
+  acquiresleep(&ip->lock);
+  ifill(ip);
+}
+
+// Lock the given inode for reading only.
+// Any number of readers may hold it at once; the caller
+// may examine ip->xxx and call readi() but not modify either.
+void
+ilockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilockshared");
+
+  acquiresleepshared(&ip->lock);
+  if(ip->valid)
+    return;
+
+  // First use: load the inode exclusively, then let
+  // other readers in.
+  releasesleepshared(&ip->lock);
+  acquiresleep(&ip->lock);
+  ifill(ip);
+  downgradesleep(&ip->lock);
+}
+
+// Unlock the given inode, whichever mode it was locked in.
 void
 iunlock(struct inode *ip)
 {
-  if(ip == 0 || !holdingsleep(&ip->lock) || ip->ref < 1)
+  if(ip == 0 || ip->ref < 1)
     panic("iunlock");
 
-  releasesleep(&ip->lock);
+  if(holdingsleep(&ip->lock))
+    releasesleep(&ip->lock);
+  else if(holdingsleepshared(&ip->lock))
+    releasesleepshared(&ip->lock);
+  else
+    panic("iunlock");
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode cache entry can
-// be recycled.
+// If that was the last reference, the inode cache entry goes
+// on the LRU list, to be found again by iget() or trimmed.
 // If that was the last reference and the inode has no links
-// to it, free the inode (and its content) on disk.
+// to it, free the inode (and its content) on disk, and the
+// cache entry with it.
 // All calls to iput() must be inside a transaction in
 // case it has to free the inode.
 void
 iput(struct inode *ip)
 {
+  struct ibucket *bk = &icache.bucket[IHASH(ip->dev, ip->inum)];
+
   acquiresleep(&ip->lock);
   if(ip->valid && ip->nlink == 0){
-    acquire(&icache.lock);
+    acquire(&bk->lock);
     int r = ip->ref;
-    release(&icache.lock);
+    release(&bk->lock);
     if(r == 1){
       // inode has no links and no other references: truncate and free.
       itrunc(ip);
       ip->type = 0;
       iupdate(ip);
+      ifree(ip->dev, ip->inum);
       ip->valid = 0;
     }
   }
   releasesleep(&ip->lock);
 
+  acquire(&bk->lock);
+  if(--ip->ref > 0){
+    release(&bk->lock);
+    return;
+  }
+  if(!ip->valid){
+    // Freed on disk, or never read: nothing worth keeping.
+    ihash_remove(bk, ip);
+    release(&bk->lock);
+    kmem_cache_free(&inodecache, ip);
+    return;
+  }
   acquire(&icache.lock);
-  ip->ref--;
+  ip->lruprev = 0;
+  ip->lrunext = icache.lruhead;
+  if(icache.lruhead)
+    icache.lruhead->lruprev = ip;
+  else
+    icache.lrutail = ip;
+  icache.lruhead = ip;
+  icache.nunused++;
   release(&icache.lock);
+  release(&bk->lock);
+
+  lru_trim();
 }
 
 // Common idiom: unlock, then put.
@@ -369,28 +587,36 @@ iunlockput(struct inode *ip)
 
 // Return the disk block address of the nth block in inode ip.
 // If there is no such block, bmap allocates one.
+// Returns 0 if it is out of disk space.
+// Directory contents are metadata; other content is file data.
 static uint
 bmap(struct inode *ip, uint bn)
 {
   uint addr, *a;
   struct buf *bp;
+  int data = ip->type != T_DIR;
 
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+      ip->addrs[bn] = addr = balloc(ip->dev, data);
     return addr;
   }
   bn -= NDIRECT;
 
-  if(bn < NINDIRECT){
+  if(bn < NINDIRECT(sb)){
     // Load indirect block, allocating if necessary.
-    if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
+    if((addr = ip->addrs[NDIRECT]) == 0){
+      if((addr = balloc(ip->dev, 0)) == 0)
+        return 0;
+      ip->addrs[NDIRECT] = addr;
+    }
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
     if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
-      log_write(bp);
+      if((addr = balloc(ip->dev, data)) != 0){
+        a[bn] = addr;
+        log_write(bp);
+      }
     }
     brelse(bp);
     return addr;
@@ -421,7 +647,7 @@ itrunc(struct inode *ip)
   if(ip->addrs[NDIRECT]){
     bp = bread(ip->dev, ip->addrs[NDIRECT]);
     a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
+    for(j = 0; j < NINDIRECT(sb); j++){
       if(a[j])
         bfree(ip->dev, a[j]);
     }
@@ -435,7 +661,7 @@ itrunc(struct inode *ip)
 }
 
 // Copy stat information from inode.
-// Caller must hold ip->lock.
+// Caller must hold ip->lock, shared or exclusive.
 void
 stati(struct inode *ip, struct stat *st)
 {
@@ -444,15 +670,16 @@ stati(struct inode *ip, struct stat *st)
   st->type = ip->type;
   st->nlink = ip->nlink;
   st->size = ip->size;
+  st->blksize = sb.bsize;
 }
 
 //PAGEBREAK!
 // Read data from inode.
-// Caller must hold ip->lock.
+// Caller must hold ip->lock, shared or exclusive.
 int
 readi(struct inode *ip, char *dst, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, addr;
   struct buf *bp;
 
   if(ip->type == T_DEV){
@@ -467,21 +694,24 @@ readi(struct inode *ip, char *dst, uint off, uint n)
     n = ip->size - off;
 
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
-    m = min(n - tot, BSIZE - off%BSIZE);
-    memmove(dst, bp->data + off%BSIZE, m);
+    if((addr = bmap(ip, off/sb.bsize)) == 0)
+      break;
+    bp = bread(ip->dev, addr);
+    m = min(n - tot, sb.bsize - off%sb.bsize);
+    memmove(dst, bp->data + off%sb.bsize, m);
     brelse(bp);
   }
-  return n;
+  return tot;
 }
 
 // PAGEBREAK!
 // Write data to inode.
+// Returns the number of bytes written, short if the disk is full.
 // Caller must hold ip->lock.
 int
 writei(struct inode *ip, char *src, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, addr;
   struct buf *bp;
 
   if(ip->type == T_DEV){
@@ -492,22 +722,30 @@ writei(struct inode *ip, char *src, uint off, uint n)
 
   if(off > ip->size || off + n < off)
     return -1;
-  if(off + n > MAXFILE*BSIZE)
+  if(off + n > MAXFILE(sb)*sb.bsize)
     return -1;
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
-    m = min(n - tot, BSIZE - off%BSIZE);
-    memmove(bp->data + off%BSIZE, src, m);
-    log_write(bp);
+    if((addr = bmap(ip, off/sb.bsize)) == 0)
+      break;
+    bp = bread(ip->dev, addr);
+    m = min(n - tot, sb.bsize - off%sb.bsize);
+    memmove(bp->data + off%sb.bsize, src, m);
+    if(ip->type == T_DIR)
+      log_write(bp);
+    else
+      log_ordered(bp);
     brelse(bp);
   }
 
-  if(n > 0 && off > ip->size){
-    ip->size = off;
+  // A short write may still have added an indirect block to
+  // ip->addrs[] before running out, so write the i-node back.
+  if(off > ip->size || tot < n){
+    if(off > ip->size)
+      ip->size = off;
     iupdate(ip);
   }
-  return n;
+  return tot;
 }
 
 //PAGEBREAK!
@@ -572,7 +810,7 @@ dirlink(struct inode *dp, char *name, uint inum)
   strncpy(de.name, name, DIRSIZ);
   de.inum = inum;
   if(writei(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
-    panic("dirlink");
+    return -1;  // out of disk space
 
   return 0;
 }
@@ -632,7 +870,7 @@ namex(char *path, int nameiparent, char *name)
     ip = idup(myproc()->cwd);
 
   while((path = skipelem(path, name)) != 0){
-    ilock(ip);
+    ilockshared(ip);
     if(ip->type != T_DIR){
       iunlockput(ip);
       return 0;
@@ -3,11 +3,19 @@
 
 
 #define ROOTINO 1  // root i-number
-#define BSIZE 512  // block size
+#define MINBSIZE 512   // smallest block size: one sector
+#define MAXBSIZE 4096  // largest block size, and mkfs's default
+#define SBOFF 512      // byte offset of the super block: sector 1
 
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
-//                                          free bit map | data blocks]
+//                          inode bit map | free bit map | data blocks]
+//
+// mkfs chooses the block size, a power of two from MINBSIZE to
+// MAXBSIZE; blocks are numbered in that size. The super block is
+// always at byte SBOFF, so it can be found before the block size
+// is known: for 512-byte blocks it is block 1, for larger ones it
+// shares block 0 with the boot sector.
 //
 // mkfs computes the super block and builds an initial file system. The
 // super block describes the disk layout:
@@ -19,11 +27,13 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint bsize;        // Block size (bytes)
+  uint imapstart;    // Block number of first inode map block
 };
 
 #define NDIRECT 12
-#define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define NINDIRECT(sb) ((sb).bsize / sizeof(uint))
+#define MAXFILE(sb) (NDIRECT + NINDIRECT(sb))
 
 // On-disk inode structure
 struct dinode {
@@ -36,16 +46,19 @@ struct dinode {
 };
 
 // Inodes per block.
-#define IPB           (BSIZE / sizeof(struct dinode))
+#define IPB(sb)       ((sb).bsize / sizeof(struct dinode))
 
 // Block containing inode i
-#define IBLOCK(i, sb)     ((i) / IPB + sb.inodestart)
+#define IBLOCK(i, sb)     ((i) / IPB(sb) + (sb).inodestart)
 
 // Bitmap bits per block
-#define BPB           (BSIZE*8)
+#define BPB(sb)       ((sb).bsize*8)
 
 // Block of free map containing bit for block b
-#define BBLOCK(b, sb) (b/BPB + sb.bmapstart)
+#define BBLOCK(b, sb) ((b)/BPB(sb) + (sb).bmapstart)
+
+// Block of inode map containing bit for inode i
+#define IMBLOCK(i, sb) ((i)/BPB(sb) + (sb).imapstart)
 
 // Directory is a file containing a sequence of dirent structures.
 #define DIRSIZ 14
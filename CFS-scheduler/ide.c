@@ -24,12 +24,19 @@
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
 
+// Sectors per RDMUL/WRMUL data block: the drive's default
+// multiple count, which a request may not exceed.
+#define IDE_MULT      16
+
 // idequeue points to the buf now being read/written to the disk.
 // idequeue->qnext points to the next buf to be processed.
+// Writes of adjacent blocks queued back to back go out as one
+// request; idenbuf counts the bufs in the active request.
 // You must hold idelock while manipulating queue.
 
 static struct spinlock idelock;
 static struct buf *idequeue;
+static int idenbuf;
 
 static int havedisk1;
 static void idestart(struct buf*);
@@ -69,31 +76,44 @@ ideinit(void)
   outb(0x1f6, 0xe0 | (0<<4));
 }
 
-// Start the request for b.  Caller must hold idelock.
+// Start the request for b, and for the writes of the blocks
+// right after b's queued behind it.  Caller must hold idelock.
 static void
 idestart(struct buf *b)
 {
+  struct buf *q;
+  int i, n;
+
   if(b == 0)
     panic("idestart");
   if(b->blockno >= FSSIZE)
     panic("incorrect blockno");
-  int sector_per_block =  BSIZE/SECTOR_SIZE;
+  int sector_per_block =  bsize/SECTOR_SIZE;
   int sector = b->blockno * sector_per_block;
-  int read_cmd = (sector_per_block == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
-  int write_cmd = (sector_per_block == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
 
-  if (sector_per_block > 7) panic("idestart");
+  if (sector_per_block > IDE_MULT) panic("idestart");
+
+  n = 1;
+  if(b->flags & B_DIRTY)
+    for(q = b; (n+1)*sector_per_block <= IDE_MULT && (q = q->qnext) != 0; n++)
+      if(!(q->flags & B_DIRTY) || q->dev != b->dev || q->blockno != b->blockno+n)
+        break;
+  idenbuf = n;
+
+  int read_cmd = (sector_per_block == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
+  int write_cmd = (n*sector_per_block == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
 
   idewait(0);
   outb(0x3f6, 0);  // generate interrupt
-  outb(0x1f2, sector_per_block);  // number of sectors
+  outb(0x1f2, n*sector_per_block);  // number of sectors
   outb(0x1f3, sector & 0xff);
   outb(0x1f4, (sector >> 8) & 0xff);
   outb(0x1f5, (sector >> 16) & 0xff);
   outb(0x1f6, 0xe0 | ((b->dev&1)<<4) | ((sector>>24)&0x0f));
   if(b->flags & B_DIRTY){
     outb(0x1f7, write_cmd);
-    outsl(0x1f0, b->data, BSIZE/4);
+    for(q = b, i = 0; i < n; q = q->qnext, i++)
+      outsl(0x1f0, q->data, bsize/4);
   } else {
     outb(0x1f7, read_cmd);
   }
@@ -104,24 +124,28 @@ void
 ideintr(void)
 {
   struct buf *b;
+  int i;
 
-  // First queued buffer is the active request.
+  // First idenbuf queued buffers are the active request.
   acquire(&idelock);
 
   if((b = idequeue) == 0){
     release(&idelock);
     return;
   }
-  idequeue = b->qnext;
 
   // Read data if needed.
   if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
-    insl(0x1f0, b->data, BSIZE/4);
-
-  // Wake process waiting for this buf.
-  b->flags |= B_VALID;
-  b->flags &= ~B_DIRTY;
-  wakeup(b);
+    insl(0x1f0, b->data, bsize/4);
+
+  // Wake processes waiting for these bufs.
+  for(i = 0; i < idenbuf; i++){
+    b = idequeue;
+    idequeue = b->qnext;
+    b->flags |= B_VALID;
+    b->flags &= ~B_DIRTY;
+    wakeup(b);
+  }
 
   // Start disk on next buf in queue.
   if(idequeue != 0)
@@ -166,3 +190,43 @@ iderw(struct buf *b)
 
   release(&idelock);
 }
+
+// Write the n locked, dirty bufs in bs to disk, in that order.
+// They are queued back to back, so runs of adjacent blocks
+// go out as single requests.
+void
+idewritev(struct buf **bs, int n)
+{
+  struct buf **pp;
+  int i;
+
+  for(i = 0; i < n; i++){
+    if(!holdingsleep(&bs[i]->lock))
+      panic("idewritev: buf not locked");
+    if(!(bs[i]->flags & B_DIRTY))
+      panic("idewritev: nothing to do");
+    if(bs[i]->dev != 0 && !havedisk1)
+      panic("idewritev: ide disk 1 not present");
+  }
+  if(n == 0)
+    return;
+
+  acquire(&idelock);
+
+  for(pp=&idequeue; *pp; pp=&(*pp)->qnext)
+    ;
+  for(i = 0; i < n; i++){
+    bs[i]->qnext = 0;
+    *pp = bs[i];
+    pp = &bs[i]->qnext;
+  }
+
+  if(idequeue == bs[0])
+    idestart(bs[0]);
+
+  for(i = 0; i < n; i++)
+    while((bs[i]->flags & (B_VALID|B_DIRTY)) != B_VALID)
+      sleep(bs[i], &idelock);
+
+  release(&idelock);
+}
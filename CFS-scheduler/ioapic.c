@@ -5,6 +5,7 @@
 #include "types.h"
 #include "defs.h"
 #include "traps.h"
+#include "spinlock.h"
 
 #define IOAPIC  0xFEC00000   // Default physical address of IO APIC
 
@@ -24,6 +25,13 @@
 
 volatile struct ioapic *ioapic;
 
+// IRQs enabled by ioapicenable(), which ioapicroute() may move.
+// The lock keeps a register select and its data write together.
+static struct {
+  struct spinlock lock;
+  uint enabled;
+} irqs;
+
 // IO APIC MMIO structure: write reg, then read or write data.
 struct ioapic {
   uint reg;
@@ -50,6 +58,7 @@ ioapicinit(void)
 {
   int i, id, maxintr;
 
+  initlock(&irqs.lock, "ioapic");
   ioapic = (volatile struct ioapic*)IOAPIC;
   maxintr = (ioapicread(REG_VER) >> 16) & 0xFF;
   id = ioapicread(REG_ID) >> 24;
@@ -72,4 +81,18 @@ ioapicenable(int irq, int cpunum)
   // which happens to be that cpu's APIC ID.
   ioapicwrite(REG_TABLE+2*irq, T_IRQ0 + irq);
   ioapicwrite(REG_TABLE+2*irq+1, cpunum << 24);
+  irqs.enabled |= 1 << irq;
+}
+
+// Steer an enabled interrupt to another CPU, given by APIC ID.
+// Returns -1 if irq was never enabled.
+int
+ioapicroute(int irq, int cpunum)
+{
+  if(irq < 0 || irq >= 32 || !(irqs.enabled & (1 << irq)))
+    return -1;
+  acquire(&irqs.lock);
+  ioapicwrite(REG_TABLE+2*irq+1, cpunum << 24);
+  release(&irqs.lock);
+  return 0;
 }
@@ -0,0 +1,8 @@
+// Decaying load averages, filled in by getloadavg().
+// Each is of SCHED_CAPACITY_SCALE (1024) except load, which is
+// also multiplied by the weight (1024 at nice 0).
+struct loadavg {
+  uint load_avg;      // Runnable time, times weight
+  uint runnable_avg;  // Runnable time (a queue: tasks runnable)
+  uint util_avg;      // Running time
+};
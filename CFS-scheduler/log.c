@@ -5,6 +5,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "workqueue.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -20,6 +21,14 @@
 // But if it thinks the log is close to running out, it
 // sleeps until the last outstanding end_op() commits.
 //
+// Commits are delayed: the modified blocks of many system calls
+// stay pinned in the buffer cache, and repeated writes to a block
+// reach the disk once. A transaction commits when the log cannot
+// take another op, when it is COMMIT_INTERVAL old (see logflush),
+// or when log_sync() asks for it. Once a commit is due, begin_op()
+// waits, and the last outstanding end_op() queues the commit on
+// the log's own kernel thread.
+//
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
 //   header block, containing block #s for block A, B, C, ...
@@ -27,7 +36,25 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// Log appends are synchronous. Log and home blocks are written
+// in sorted batches so that adjacent blocks share a disk request.
+//
+// Only metadata (bitmap, inode, indirect and directory blocks) is
+// logged. File data is ordered instead: log_ordered() pins it in
+// the cache, and commit() writes it to its home location before
+// the log, so a committed inode never points at stale data.
+// Blocks freed by the open transaction are not reallocated until
+// it commits (see log_freed()): otherwise data written over one
+// could reach the disk while the free is still undone. If they
+// are all that is left, balloc() fails and asks for an early
+// commit (log_nospace()); filewrite() waits for it and retries.
+
+#define COMMIT_INTERVAL 1000 // ms a logged change may wait in memory
+#define LOGDIRTY (LOGSIZE - MAXOPBLOCKS) // commit once lh.n is past this
+#define DATADIRTY (DATASIZE - MAXOPDATA) // or ndata is past this
+#define LOGCHUNK 16          // blocks written per batch
+
+extern u64 us; // in trap.c
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -41,19 +68,27 @@ struct log {
   int start;
   int size;
   int outstanding; // how many FS sys calls are executing.
-  int committing;  // in commit(), please wait.
+  int committing;  // commit due or in commit(), please wait.
   int dev;
+  uint ncommit;    // commits completed, for log_sync()
   struct logheader lh;
+  int ndata;       // ordered data blocks in data[]
+  int data[DATASIZE];
+  uchar freed[(FSSIZE+7)/8]; // blocks freed by the open transaction
+  struct workqueue wq;       // runs commitwork
+  struct work commitwork;
 };
 struct log log;
 
 static void recover_from_log(void);
 static void commit();
+static void commitfn(struct work*);
+static void logflush(void*);
 
 void
 initlog(int dev)
 {
-  if (sizeof(struct logheader) >= BSIZE)
+  if (sizeof(struct logheader) >= bsize)
     panic("initlog: too big logheader");
 
   struct superblock sb;
@@ -63,18 +98,57 @@ initlog(int dev)
   log.size = sb.nlog;
   log.dev = dev;
   recover_from_log();
+
+  // Commits block every FS system call, so run them ahead of
+  // ordinary processes.
+  init_work(&log.commitwork, commitfn);
+  init_workqueue(&log.wq, "logcommit", -5);
+  if(kthread_create(logflush, 0, "logflush", 0) < 0)
+    panic("initlog: logflush");
+}
+
+// Sort block numbers, so batches write adjacent blocks together.
+static void
+sortblocks(int *b, int n)
+{
+  int i, j, x;
+
+  for(i = 1; i < n; i++){
+    x = b[i];
+    for(j = i; j > 0 && b[j-1] > x; j--)
+      b[j] = b[j-1];
+    b[j] = x;
+  }
 }
 
-// Copy committed blocks from log to their home location
+// Copy committed blocks from log to their home location.
+// After a commit the cache still holds them, pinned, so they
+// are written from there in block order; recovery reads the log.
 static void
-install_trans(void)
+install_trans(int recovering)
 {
-  int tail;
+  struct buf *bs[LOGCHUNK];
+  int block[LOGSIZE];
+  int tail, i, n;
+
+  if(!recovering){
+    memmove(block, log.lh.block, log.lh.n * sizeof(int));
+    sortblocks(block, log.lh.n);
+    for(tail = 0; tail < log.lh.n; tail += n){
+      n = log.lh.n - tail < LOGCHUNK ? log.lh.n - tail : LOGCHUNK;
+      for(i = 0; i < n; i++)
+        bs[i] = bread(log.dev, block[tail+i]);
+      bwritev(bs, n);
+      for(i = 0; i < n; i++)
+        brelse(bs[i]);
+    }
+    return;
+  }
 
   for (tail = 0; tail < log.lh.n; tail++) {
     struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
     struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
+    memmove(dbuf->data, lbuf->data, bsize);  // copy block to dst
     bwrite(dbuf);  // write dst to disk
     brelse(lbuf);
     brelse(dbuf);
@@ -116,7 +190,7 @@ static void
 recover_from_log(void)
 {
   read_head();
-  install_trans(); // if committed, copy from log to disk
+  install_trans(1); // if committed, copy from log to disk
   log.lh.n = 0;
   write_head(); // clear the log
 }
@@ -129,7 +203,8 @@ begin_op(void)
   while(1){
     if(log.committing){
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
+    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE ||
+              log.ndata + (log.outstanding+1)*MAXOPDATA > DATASIZE){
       // this op might exhaust log space; wait for commit.
       sleep(&log, &log.lock);
     } else {
@@ -140,20 +215,28 @@ begin_op(void)
   }
 }
 
+// Make a commit due, and queue it if no operation is left.
+// Caller must hold log.lock.
+static void
+start_commit(void)
+{
+  log.committing = 1;
+  // commit() sleeps, so it cannot run under log.lock; it runs
+  // on the log's worker instead of delaying the caller.
+  if(log.outstanding == 0)
+    queue_work(&log.wq, &log.commitwork);
+}
+
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
+// commits if this was the last outstanding operation
+// and a commit is due.
 void
 end_op(void)
 {
-  int do_commit = 0;
-
   acquire(&log.lock);
   log.outstanding -= 1;
-  if(log.committing)
-    panic("log.committing");
-  if(log.outstanding == 0){
-    do_commit = 1;
-    log.committing = 1;
+  if(log.committing || log.lh.n > LOGDIRTY || log.ndata > DATADIRTY){
+    start_commit();
   } else {
     // begin_op() may be waiting for log space,
     // and decrementing log.outstanding has decreased
@@ -161,44 +244,108 @@ end_op(void)
     wakeup(&log);
   }
   release(&log.lock);
+}
+
+static void
+commitfn(struct work *w)
+{
+  commit();
+  acquire(&log.lock);
+  log.committing = 0;
+  log.ncommit++;
+  wakeup(&log);
+  release(&log.lock);
+}
+
+// Commit what has been logged every COMMIT_INTERVAL, so no
+// change waits in memory for longer than that.
+static void
+logflush(void *arg)
+{
+  for(;;){
+    acquire(&tickslock);
+    timer_sleep(us + COMMIT_INTERVAL*1000ULL);
+    release(&tickslock);
 
-  if(do_commit){
-    // call commit w/o holding locks, since not allowed
-    // to sleep with locks.
-    commit();
     acquire(&log.lock);
-    log.committing = 0;
-    wakeup(&log);
+    if((log.lh.n > 0 || log.ndata > 0) && !log.committing)
+      start_commit();
     release(&log.lock);
   }
 }
 
+// Wait until everything logged so far is committed.
+// Later operations cannot join a commit in progress, so what is
+// logged now goes out with the next commit to complete.
+void
+log_sync(void)
+{
+  uint target;
+
+  acquire(&log.lock);
+  if(log.lh.n > 0 || log.ndata > 0 || log.committing){
+    target = log.ncommit + 1;
+    if(!log.committing)
+      start_commit();
+    while((int)(log.ncommit - target) < 0)
+      sleep(&log, &log.lock);
+  }
+  release(&log.lock);
+}
+
 // Copy modified blocks from cache to log.
+// Log blocks are adjacent, so each batch is one disk request.
 static void
 write_log(void)
 {
-  int tail;
+  struct buf *to[LOGCHUNK];
+  int tail, i, n;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
-    brelse(from);
-    brelse(to);
+  for (tail = 0; tail < log.lh.n; tail += n) {
+    n = log.lh.n - tail < LOGCHUNK ? log.lh.n - tail : LOGCHUNK;
+    for (i = 0; i < n; i++) {
+      to[i] = getblk(log.dev, log.start+tail+i+1); // log block
+      struct buf *from = bread(log.dev, log.lh.block[tail+i]); // cache block
+      memmove(to[i]->data, from->data, bsize);
+      brelse(from);
+    }
+    bwritev(to, n);  // write the log
+    for (i = 0; i < n; i++)
+      brelse(to[i]);
+  }
+}
+
+// Write the ordered data blocks to their home locations.
+static void
+write_data(void)
+{
+  struct buf *bs[LOGCHUNK];
+  int tail, i, n;
+
+  sortblocks(log.data, log.ndata);
+  for (tail = 0; tail < log.ndata; tail += n) {
+    n = log.ndata - tail < LOGCHUNK ? log.ndata - tail : LOGCHUNK;
+    for (i = 0; i < n; i++)
+      bs[i] = bread(log.dev, log.data[tail+i]);
+    bwritev(bs, n);
+    for (i = 0; i < n; i++)
+      brelse(bs[i]);
   }
+  log.ndata = 0;
 }
 
 static void
 commit()
 {
+  write_data();      // Data first, so metadata never points at stale blocks
   if (log.lh.n > 0) {
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
+    install_trans(0); // Now install writes to home locations
     log.lh.n = 0;
     write_head();    // Erase the transaction from the log
   }
+  memset(log.freed, 0, sizeof(log.freed));
 }
 
 // Caller has modified b->data and is done with the buffer.
@@ -232,3 +379,62 @@ log_write(struct buf *b)
   release(&log.lock);
 }
 
+
+// Caller has modified b->data, which holds file data, and is
+// done with the buffer. Pin it in the cache with B_DIRTY like
+// log_write(), but commit() writes it to its home location,
+// ahead of the log, instead of into the log.
+void
+log_ordered(struct buf *b)
+{
+  int i;
+
+  if (log.outstanding < 1)
+    panic("log_ordered outside of trans");
+
+  acquire(&log.lock);
+  for (i = 0; i < log.ndata; i++) {
+    if (log.data[i] == b->blockno)   // written once per commit
+      break;
+  }
+  if (i == log.ndata) {
+    if (log.ndata >= DATASIZE)
+      panic("too much ordered data");
+    log.data[log.ndata++] = b->blockno;
+  }
+  b->flags |= B_DIRTY; // prevent eviction
+  release(&log.lock);
+}
+
+// Block b has been freed by the current transaction.
+void
+log_free(uint b)
+{
+  acquire(&log.lock);
+  log.freed[b/8] |= 1 << (b%8);
+  release(&log.lock);
+}
+
+// balloc() found free blocks only among those freed by the open
+// transaction: commit it as soon as the running operations end.
+void
+log_nospace(void)
+{
+  acquire(&log.lock);
+  if(!log.committing)
+    start_commit();
+  release(&log.lock);
+}
+
+// May block b, free in the bitmap, not be reused yet?
+// Only once the transaction that freed it has committed.
+int
+log_freed(uint b)
+{
+  int r;
+
+  acquire(&log.lock);
+  r = (log.freed[b/8] & (1 << (b%8))) != 0;
+  release(&log.lock);
+  return r;
+}
@@ -22,7 +22,7 @@ void
 ideinit(void)
 {
   memdisk = _binary_fs_img_start;
-  disksize = (uint)_binary_fs_img_size/BSIZE;
+  disksize = (uint)_binary_fs_img_size;
 }
 
 // Interrupt handler.
@@ -46,15 +46,24 @@ iderw(struct buf *b)
     panic("iderw: nothing to do");
   if(b->dev != 1)
     panic("iderw: request not for disk 1");
-  if(b->blockno >= disksize)
+  if(b->blockno >= disksize/bsize)
     panic("iderw: block out of range");
 
-  p = memdisk + b->blockno*BSIZE;
+  p = memdisk + b->blockno*bsize;
 
   if(b->flags & B_DIRTY){
     b->flags &= ~B_DIRTY;
-    memmove(p, b->data, BSIZE);
+    memmove(p, b->data, bsize);
   } else
-    memmove(b->data, p, BSIZE);
+    memmove(b->data, p, bsize);
   b->flags |= B_VALID;
 }
+
+void
+idewritev(struct buf **bs, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++)
+    iderw(bs[i]);
+}
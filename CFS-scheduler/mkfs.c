@@ -18,22 +18,28 @@
 #define NINODES 200
 
 // Disk layout:
-// [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
-
-int nbitmap = FSSIZE/(BSIZE*8) + 1;
-int ninodeblocks = NINODES / IPB + 1;
+// [ boot block | sb block | log | inode blocks | inode bit map |
+//                                           free bit map | data blocks ]
+// With blocks larger than 512 bytes, boot and sb share block 0.
+
+int bsize = MAXBSIZE;
+int nsb;      // Number of boot and sb blocks
+int nbitmap;
+int ninodeblocks;
+int nimap;    // Number of inode bit map blocks
 int nlog = LOGSIZE;
-int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
+int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, inode map, bitmap)
 int nblocks;  // Number of data blocks
 
 int fsfd;
 struct superblock sb;
-char zeroes[BSIZE];
+char zeroes[MAXBSIZE];
 uint freeinode = 1;
 uint freeblock;
 
 
 void balloc(int);
+void imap(int);
 void wsect(uint, void*);
 void winode(uint, struct dinode*);
 void rinode(uint inum, struct dinode *ip);
@@ -70,19 +76,29 @@ main(int argc, char *argv[])
   int i, cc, fd;
   uint rootino, inum, off;
   struct dirent de;
-  char buf[BSIZE];
+  char buf[MAXBSIZE];
   struct dinode din;
 
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
+  if(argc > 2 && strcmp(argv[1], "-b") == 0){
+    bsize = atoi(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
   if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+    fprintf(stderr, "Usage: mkfs [-b blocksize] fs.img files...\n");
+    exit(1);
+  }
+  if(bsize < MINBSIZE || bsize > MAXBSIZE || (bsize & (bsize-1)) != 0){
+    fprintf(stderr, "mkfs: block size must be a power of 2 from %d to %d\n",
+            MINBSIZE, MAXBSIZE);
     exit(1);
   }
 
-  assert((BSIZE % sizeof(struct dinode)) == 0);
-  assert((BSIZE % sizeof(struct dirent)) == 0);
+  assert((bsize % sizeof(struct dinode)) == 0);
+  assert((bsize % sizeof(struct dirent)) == 0);
 
   fsfd = open(argv[1], O_RDWR|O_CREAT|O_TRUNC, 0666);
   if(fsfd < 0){
@@ -90,20 +106,26 @@ main(int argc, char *argv[])
     exit(1);
   }
 
-  // 1 fs block = 1 disk sector
-  nmeta = 2 + nlog + ninodeblocks + nbitmap;
+  // FSSIZE blocks of bsize bytes each
+  sb.bsize = xint(bsize);
+  nsb = (SBOFF + MINBSIZE + bsize - 1) / bsize;
+  nbitmap = FSSIZE/BPB(sb) + 1;
+  ninodeblocks = NINODES / IPB(sb) + 1;
+  nimap = NINODES/BPB(sb) + 1;
+  nmeta = nsb + nlog + ninodeblocks + nimap + nbitmap;
   nblocks = FSSIZE - nmeta;
 
   sb.size = xint(FSSIZE);
   sb.nblocks = xint(nblocks);
   sb.ninodes = xint(NINODES);
   sb.nlog = xint(nlog);
-  sb.logstart = xint(2);
-  sb.inodestart = xint(2+nlog);
-  sb.bmapstart = xint(2+nlog+ninodeblocks);
+  sb.logstart = xint(nsb);
+  sb.inodestart = xint(nsb+nlog);
+  sb.imapstart = xint(nsb+nlog+ninodeblocks);
+  sb.bmapstart = xint(nsb+nlog+ninodeblocks+nimap);
 
-  printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
-         nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
+  printf("nmeta %d (boot, super, log blocks %u inode blocks %u, inode map blocks %u, bitmap blocks %u) blocks %d total %d of %d bytes\n",
+         nmeta, nlog, ninodeblocks, nimap, nbitmap, nblocks, FSSIZE, bsize);
 
   freeblock = nmeta;     // the first free block that we can allocate
 
@@ -111,8 +133,8 @@ main(int argc, char *argv[])
     wsect(i, zeroes);
 
   memset(buf, 0, sizeof(buf));
-  memmove(buf, &sb, sizeof(sb));
-  wsect(1, buf);
+  memmove(buf + SBOFF % bsize, &sb, sizeof(sb));
+  wsect(SBOFF / bsize, buf);
 
   rootino = ialloc(T_DIR);
   assert(rootino == ROOTINO);
@@ -158,11 +180,12 @@ main(int argc, char *argv[])
   // fix size of root inode dir
   rinode(rootino, &din);
   off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
+  off = ((off/bsize) + 1) * bsize;
   din.size = xint(off);
   winode(rootino, &din);
 
   balloc(freeblock);
+  imap(freeinode);
 
   exit(0);
 }
@@ -170,11 +193,11 @@ main(int argc, char *argv[])
 void
 wsect(uint sec, void *buf)
 {
-  if(lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE){
+  if(lseek(fsfd, sec * bsize, 0) != sec * bsize){
     perror("lseek");
     exit(1);
   }
-  if(write(fsfd, buf, BSIZE) != BSIZE){
+  if(write(fsfd, buf, bsize) != bsize){
     perror("write");
     exit(1);
   }
@@ -183,13 +206,13 @@ wsect(uint sec, void *buf)
 void
 winode(uint inum, struct dinode *ip)
 {
-  char buf[BSIZE];
+  char buf[MAXBSIZE];
   uint bn;
   struct dinode *dip;
 
   bn = IBLOCK(inum, sb);
   rsect(bn, buf);
-  dip = ((struct dinode*)buf) + (inum % IPB);
+  dip = ((struct dinode*)buf) + (inum % IPB(sb));
   *dip = *ip;
   wsect(bn, buf);
 }
@@ -197,24 +220,24 @@ winode(uint inum, struct dinode *ip)
 void
 rinode(uint inum, struct dinode *ip)
 {
-  char buf[BSIZE];
+  char buf[MAXBSIZE];
   uint bn;
   struct dinode *dip;
 
   bn = IBLOCK(inum, sb);
   rsect(bn, buf);
-  dip = ((struct dinode*)buf) + (inum % IPB);
+  dip = ((struct dinode*)buf) + (inum % IPB(sb));
   *ip = *dip;
 }
 
 void
 rsect(uint sec, void *buf)
 {
-  if(lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE){
+  if(lseek(fsfd, sec * bsize, 0) != sec * bsize){
     perror("lseek");
     exit(1);
   }
-  if(read(fsfd, buf, BSIZE) != BSIZE){
+  if(read(fsfd, buf, bsize) != bsize){
     perror("read");
     exit(1);
   }
@@ -237,12 +260,12 @@ ialloc(ushort type)
 void
 balloc(int used)
 {
-  uchar buf[BSIZE];
+  uchar buf[MAXBSIZE];
   int i;
 
   printf("balloc: first %d blocks have been allocated\n", used);
-  assert(used < BSIZE*8);
-  bzero(buf, BSIZE);
+  assert(used < BPB(sb));
+  bzero(buf, bsize);
   for(i = 0; i < used; i++){
     buf[i/8] = buf[i/8] | (0x1 << (i%8));
   }
@@ -250,6 +273,23 @@ balloc(int used)
   wsect(sb.bmapstart, buf);
 }
 
+// Mark inodes 0 to used-1 in use; inode 0 is never handed out.
+void
+imap(int used)
+{
+  uchar buf[MAXBSIZE];
+  int i;
+
+  printf("imap: first %d inodes have been allocated\n", used);
+  assert(used < BPB(sb));
+  bzero(buf, bsize);
+  for(i = 0; i < used; i++){
+    buf[i/8] = buf[i/8] | (0x1 << (i%8));
+  }
+  printf("imap: write inode bitmap block at sector %d\n", sb.imapstart);
+  wsect(sb.imapstart, buf);
+}
+
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
 void
@@ -258,16 +298,16 @@ iappend(uint inum, void *xp, int n)
   char *p = (char*)xp;
   uint fbn, off, n1;
   struct dinode din;
-  char buf[BSIZE];
-  uint indirect[NINDIRECT];
+  char buf[MAXBSIZE];
+  uint indirect[MAXBSIZE / sizeof(uint)];
   uint x;
 
   rinode(inum, &din);
   off = xint(din.size);
   // printf("append inum %d at off %d sz %d\n", inum, off, n);
   while(n > 0){
-    fbn = off / BSIZE;
-    assert(fbn < MAXFILE);
+    fbn = off / bsize;
+    assert(fbn < MAXFILE(sb));
     if(fbn < NDIRECT){
       if(xint(din.addrs[fbn]) == 0){
         din.addrs[fbn] = xint(freeblock++);
@@ -284,9 +324,9 @@ iappend(uint inum, void *xp, int n)
       }
       x = xint(indirect[fbn-NDIRECT]);
     }
-    n1 = min(n, (fbn + 1) * BSIZE - off);
+    n1 = min(n, (fbn + 1) * bsize - off);
     rsect(x, buf);
-    bcopy(p, buf + off - (fbn * BSIZE), n1);
+    bcopy(p, buf + off - (fbn * bsize), n1);
     wsect(x, buf);
     n -= n1;
     off += n1;
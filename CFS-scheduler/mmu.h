@@ -11,15 +11,24 @@
 
 #define CR4_PSE         0x00000010      // Page size extension
 
+// CPUID leaf 1 feature flags, in %edx
+#define CPUID_SEP       0x00000800      // sysenter/sysexit
+
+// Model-specific registers set up for sysenter
+#define MSR_SYSENTER_CS  0x174          // kernel %cs; %ss is the next selector
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
 // various segment selectors.
 #define SEG_KCODE 1  // kernel code
 #define SEG_KDATA 2  // kernel data+stack
 #define SEG_UCODE 3  // user code
 #define SEG_UDATA 4  // user data+stack
 #define SEG_TSS   5  // this process's task state
+#define SEG_KCPU  6  // kernel per-cpu data, loaded in %gs
 
 // cpu->gdt[NSEGS] holds the above segments.
-#define NSEGS     6
+#define NSEGS     7
 
 #ifndef __ASSEMBLER__
 // Segment Descriptor
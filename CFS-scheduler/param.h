@@ -1,14 +1,17 @@
-#define NPROC        64  // maximum number of processes, default: 32
+#define NPROC      4096  // maximum number of processes, default: 32
 #define KSTACKSIZE 4096  // size of per-process kernel stack
 #define NCPU          8  // maximum number of CPUs
+#define NGROUP       64  // maximum number of task groups
 #define NOFILE       16  // open files per process, default: 16
-#define NFILE       100  // open files per system, default: 100
-#define NINODE       50  // maximum number of active i-nodes
+#define NSHARED       8  // sleeplocks a process may hold shared at once
+#define NFILE      1000  // open files per system, default: 100
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
-#define MAXOPBLOCKS  10  // max # of blocks any FS op writes
+#define MAXOPBLOCKS  10  // max # of metadata blocks any FS op writes
+#define MAXOPDATA    24  // max # of file data blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define DATASIZE     (MAXOPDATA*3)  // max file data blocks per commit
+#define NBUF         (MAXOPBLOCKS*16)  // size of disk block cache
+#define FSSIZE       2000  // size of file system in blocks
 
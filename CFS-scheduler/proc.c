@@ -6,11 +6,33 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "slab.h"
+#include "tgstat.h"
+#include "loadavg.h"
+#include "vdso.h"
+
+// Sleeping processes are hashed by wait channel so that
+// wakeup() only looks at procs that may be sleeping on it.
+#define NCHANHASH 64
+#define CHANHASH(chan) ((((uint)(chan)) * 2654435761U) >> 26)
+
+// Live processes are found through a hash on pid.
+#define NPIDHASH 256
+#define PIDHASH(pid) ((uint)(pid) % NPIDHASH)
+
+// There is no fixed process array: proc structures come from
+// an object cache, so allocation is O(1) and only NPROC bounds
+// the count.
+struct kmem_cache proccache;
 
 struct {
   struct spinlock lock;
-  struct proc proc[NPROC];
-  struct cfs_rq cfs_rq;
+  int nproc;                   // Number of allocated procs
+  struct rq rq;                  // run queues of all classes
+  struct proc *chanhash[NCHANHASH];
+  struct proc *pidhash[NPIDHASH];
+  struct task_group tg[NGROUP];  // tg[0] unused: 0 names the root
+  u64 next_refill;               // earliest bandwidth period end
 } ptable;
 
 
@@ -31,7 +53,9 @@ void
 pinit(void)
 {
   initlock(&ptable.lock, "ptable");
-  init_cfs_rq(&ptable.cfs_rq);
+  kmem_cache_init(&proccache, "proc", sizeof(struct proc));
+  init_rq(&ptable.rq, ncpu);
+  init_sched_tunables(ncpu);
 }
 
 // Must be called with interrupts disabled
@@ -40,19 +64,15 @@ cpuid() {
   return mycpu()-cpus;
 }
 
-// Must be called with interrupts disabled to avoid the caller being
-// rescheduled between reading lapicid and running through the loop.
+// Find this CPU's struct by its local APIC ID, for seginit()
+// to point %gs at. Must be called with interrupts disabled.
 struct cpu*
-mycpu(void)
+findcpu(void)
 {
   int apicid, i;
   
-  if(readeflags()&FL_IF)
-    panic("mycpu called with interrupts enabled\n");
-  
   apicid = lapicid();
-  // APIC IDs are not guaranteed to be contiguous. Maybe we should have
-  // a reverse map, or reserve a register to store &cpus[i].
+  // APIC IDs are not guaranteed to be contiguous.
   for (i = 0; i < ncpu; ++i) {
     if (cpus[i].apicid == apicid)
       return &cpus[i];
@@ -60,21 +80,51 @@ mycpu(void)
   panic("unknown apicid\n");
 }
 
-// Disable interrupts so that we are not rescheduled
-// while reading proc from the cpu structure
+// Must be called with interrupts disabled to avoid the caller being
+// rescheduled and using another CPU's struct.
+struct cpu*
+mycpu(void)
+{
+  struct cpu *c;
+  
+  if(readeflags()&FL_IF)
+    panic("mycpu called with interrupts enabled\n");
+  
+  asm volatile("movl %%gs:0, %0" : "=r" (c));
+  return c;
+}
+
+// A single load: wherever we are rescheduled after it, the
+// process running there is still this one.
 struct proc*
 myproc(void) {
-  struct cpu *c;
   struct proc *p;
-  pushcli();
-  c = mycpu();
-  p = c->proc;
-  popcli();
+
+  asm volatile("movl %%gs:4, %0" : "=r" (p));
   return p;
 }
 
+// Return p to the proc cache and drop it from the pid hash.
+// The ptable lock must be held.
+static void
+freeproc(struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &ptable.pidhash[PIDHASH(p->pid)]; *pp; pp = &(*pp)->pidnext)
+    if(*pp == p){
+      *pp = p->pidnext;
+      break;
+    }
+
+  p->pid = 0;
+  p->state = UNUSED;
+  ptable.nproc--;
+  kmem_cache_free(&proccache, p);
+}
+
 //PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
+// Allocate an UNUSED proc from the proc cache.
 // If found, change state to EMBRYO and initialize
 // state required to run in the kernel.
 // Otherwise return 0.
@@ -84,26 +134,43 @@ allocproc(void)
   struct proc *p;
   char *sp;
 
-  acquire(&ptable.lock);
+  if((p = kmem_cache_alloc(&proccache)) == 0)
+    return 0;
+  memset(p, 0, sizeof(*p));
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
+  acquire(&ptable.lock);
 
-  release(&ptable.lock);
-  return 0;
+  if(ptable.nproc >= NPROC){
+    release(&ptable.lock);
+    kmem_cache_free(&proccache, p);
+    return 0;
+  }
 
-found:
   p->state = EMBRYO;
   p->pid = nextpid++;
+  p->pidnext = ptable.pidhash[PIDHASH(p->pid)];
+  ptable.pidhash[PIDHASH(p->pid)] = p;
+  ptable.nproc++;
 
   release(&ptable.lock);
 
-  // Allocate kernel stack.
+  // Allocate kernel stack and vDSO page.
   if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
+    acquire(&ptable.lock);
+    freeproc(p);
+    release(&ptable.lock);
+    return 0;
+  }
+  if((p->vproc = kalloc()) == 0){
+    kfree(p->kstack);
+    p->kstack = 0;
+    acquire(&ptable.lock);
+    freeproc(p);
+    release(&ptable.lock);
     return 0;
   }
+  memset(p->vproc, 0, PGSIZE);
+  ((struct vdso_proc*)p->vproc)->pid = p->pid;
   sp = p->kstack + KSTACKSIZE;
 
   // Leave room for trap frame.
@@ -137,6 +204,8 @@ userinit(void)
   if((p->pgdir = setupkvm()) == 0)
     panic("userinit: out of memory?");
   inituvm(p->pgdir, _binary_initcode_start, (int)_binary_initcode_size);
+  if(mapvdso(p->pgdir, p->vproc) < 0)
+    panic("userinit: out of memory?");
   p->sz = PGSIZE;
   memset(p->tf, 0, sizeof(*p->tf));
   p->tf->cs = (SEG_UCODE << 3) | DPL_USER;
@@ -159,8 +228,66 @@ userinit(void)
   init_entity(&p->se);
   
   p->state = RUNNABLE;
-  enqueue_entity_fair(&ptable.cfs_rq, &p->se);
+  p->se.cfs_rq = &ptable.rq.cfs;
+  enqueue_task(&ptable.rq, &p->se);
+  release(&ptable.lock);
+}
+
+// First code a kernel thread runs, entered from swtch() with
+// fn and arg on the stack as if it had been called with them.
+static void
+kthreadmain(void (*fn)(void*), void *arg)
+{
+  // Still holding ptable.lock from scheduler.
+  release(&ptable.lock);
+
+  fn(arg);
+  exit();
+}
+
+// Start a kernel thread running fn(arg), scheduled by its class
+// like any process but with no user memory: it runs on kpgdir and
+// never returns to user space. If fn returns, the thread exits and
+// init reaps it. Return its pid, or -1.
+int
+kthread_create(void (*fn)(void*), void *arg, char *name, int nice)
+{
+  struct proc *np;
+  uint *sp;
+
+  if(initproc == 0)
+    panic("kthread_create before userinit");
+  if(nice < -20 || nice > 19)
+    return -1;
+  if((np = allocproc()) == 0)
+    return -1;
+  np->kthread = 1;
+
+  // swtch() returns into kthreadmain instead of forkret: the
+  // trapret slot becomes its return address, fn and arg follow.
+  np->context->eip = (uint)kthreadmain;
+  sp = (uint*)(np->context + 1);
+  sp[0] = 0;
+  sp[1] = (uint)fn;
+  sp[2] = (uint)arg;
+
+  safestrcpy(np->name, name, sizeof(np->name));
+
+  acquire(&ptable.lock);
+
+  np->parent = initproc;
+  np->sibling = initproc->child;
+  initproc->child = np;
+
+  init_entity(&np->se);
+  set_nice_entity(&np->se, nice);
+  place_new_entity(&ptable.rq.cfs, &np->se);
+
+  np->state = RUNNABLE;
+  enqueue_task(&ptable.rq, &np->se);
   release(&ptable.lock);
+
+  return np->pid;
 }
 
 // Grow current process's memory by n bytes.
@@ -200,10 +327,18 @@ fork(void)
   }
 
   // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
+  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0 ||
+     mapvdso(np->pgdir, np->vproc) < 0){
+    if(np->pgdir)
+      freevm(np->pgdir);
+    np->pgdir = 0;
     kfree(np->kstack);
     np->kstack = 0;
-    np->state = UNUSED;
+    kfree(np->vproc);
+    np->vproc = 0;
+    acquire(&ptable.lock);
+    freeproc(np);
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
@@ -224,12 +359,15 @@ fork(void)
 
   acquire(&ptable.lock);
 
+  np->sibling = curproc->child;
+  curproc->child = np;
+
   copy_entity(&curproc->se, &np->se);
 
   np->state = RUNNABLE;
 
   struct sched_entity *nse = &np->se;
-  enqueue_entity_fair(nse->cfs_rq, nse);
+  enqueue_task(&ptable.rq, nse);
   if(ALLOW_LOG)
     cprintf("[fork] pid: %d, nr: %d\n", np->pid, nse->cfs_rq->nr_running);
 
@@ -259,10 +397,12 @@ exit(void)
     }
   }
 
-  begin_op();
-  iput(curproc->cwd);
-  end_op();
-  curproc->cwd = 0;
+  if(curproc->cwd){
+    begin_op();
+    iput(curproc->cwd);
+    end_op();
+    curproc->cwd = 0;
+  }
 
   acquire(&ptable.lock);
 
@@ -270,19 +410,24 @@ exit(void)
   wakeup1(curproc->parent);
 
   // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->parent == curproc){
+  if(curproc->child){
+    for(p = curproc->child; ; p = p->sibling){
       p->parent = initproc;
       if(p->state == ZOMBIE)
         wakeup1(initproc);
+      if(p->sibling == 0)
+        break;
     }
+    p->sibling = initproc->child;
+    initproc->child = curproc->child;
+    curproc->child = 0;
   }
 
   // Jump into the scheduler, never to return.
   curproc->state = ZOMBIE;
 
   struct sched_entity *se = &curproc->se;
-	dequeue_entity_fair(&ptable.cfs_rq, se);
+  exit_task(&ptable.rq, se);
   
   //cprintf("[exit] pid: %d, tot us: %d\n", curproc->pid, se->tot_exec_runtime);
 
@@ -295,29 +440,30 @@ exit(void)
 int
 wait(void)
 {
-  struct proc *p;
+  struct proc *p, **pp;
   int havekids, pid;
   struct proc *curproc = myproc();
   
   acquire(&ptable.lock);
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
-      havekids = 1;
+    // Scan through own children looking for exited ones.
+    havekids = curproc->child != 0;
+    for(pp = &curproc->child; (p = *pp) != 0; pp = &p->sibling){
       if(p->state == ZOMBIE){
         // Found one.
+        *pp = p->sibling;
         pid = p->pid;
         kfree(p->kstack);
         p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
+        kfree(p->vproc);
+        p->vproc = 0;
+        if(p->pgdir)
+          freevm(p->pgdir);
         p->parent = 0;
+        p->sibling = 0;
         p->name[0] = 0;
         p->killed = 0;
-        p->state = UNUSED;
+        freeproc(p);
         release(&ptable.lock);
         return pid;
       }
@@ -347,7 +493,7 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
-  struct cfs_rq *cfs_rq = 0;
+  struct rq *rq = &ptable.rq;
 
   c->proc = 0;
   
@@ -356,7 +502,6 @@ scheduler(void)
     sti();
 
     acquire(&ptable.lock);
-    cfs_rq = &ptable.cfs_rq;
     /*
     for (p = ptable.proc; p < &ptable.proc[NPROC]; p++) {
         if(p->state != RUNNABLE)
@@ -367,20 +512,20 @@ scheduler(void)
         swtch(&(c->scheduler), p->context);
         switchkvm();
     } */
-    p = next_proc(cfs_rq);
+    p = next_proc(rq);
     if(p) {
       c->proc = p;
       switchuvm(p);
       p->state = RUNNING;
 
-      cfs_rq->curr = &p->se;
-      dequeue_entity_fair(cfs_rq, &p->se);
+      set_curr_task(rq, &p->se, cpuid());
 
       swtch(&(c->scheduler), p->context);
       switchkvm();
+
+      put_curr_task(rq, &p->se);
     }
     c->proc = 0;
-    cfs_rq->curr = 0;
 
     release(&ptable.lock);
   }
@@ -419,29 +564,29 @@ yield(void)
   acquire(&ptable.lock);  //DOC: yieldlock
 
   struct sched_entity *se = &myproc()->se;
-  struct cfs_rq *cfs_rq = &ptable.cfs_rq;
+  struct rq *rq = &ptable.rq;
   struct proc *np = 0;
 
   /* Update current entity's sched stat */
-  update_entity_stat(cfs_rq, us);
+  se->sched_class->tick(rq, se, us);
 
   /* Check Preempt condition */
-  if(cfs_rq->nr_running < 2 || !check_yield(cfs_rq)) {
+  if(!check_preempt_curr(rq, se)) {
     release(&ptable.lock);
     return;
   }
 
   if(ALLOW_LOG) {
-    np = next_proc(cfs_rq);
+    np = next_proc(rq);
     cprintf("[YIELD: %d] curr: %d, next: %d, ", ylg++, myproc()->pid, np->pid);
     cprintf("cvr: %d, nvr: %d\n", (uint)se->vruntime, (uint)(np->se.vruntime));
   }
 
   myproc()->state = RUNNABLE;
-  enqueue_entity_fair(se->cfs_rq, se);
+  enqueue_task(rq, se);
 
   if(ALLOW_LOG) {
-    struct proc *sp = next_proc(cfs_rq);
+    struct proc *sp = next_proc(rq);
     if(sp != np)
       cprintf(">> LM Changed: %d, %d\n", sp->pid, (uint)sp->se.vruntime);
   }
@@ -450,6 +595,55 @@ yield(void)
   release(&ptable.lock);
 }
 
+// Give up the CPU to the runnable processes that are due first.
+int
+sched_yield(void)
+{
+  struct sched_entity *se = &myproc()->se;
+  struct rq *rq = &ptable.rq;
+
+  acquire(&ptable.lock);
+  se->sched_class->tick(rq, se, us);
+  yield_task(rq, se);
+
+  myproc()->state = RUNNABLE;
+  enqueue_task(rq, se);
+  sched();
+  release(&ptable.lock);
+  return 0;
+}
+
+// Give up the CPU, and what is left of the slice, to process pid,
+// which must be runnable and of the caller's policy class.
+int
+yield_to(int pid)
+{
+  struct sched_entity *se = &myproc()->se;
+  struct rq *rq = &ptable.rq;
+  struct proc *p;
+
+  acquire(&ptable.lock);
+  for(p = ptable.pidhash[PIDHASH(pid)]; p; p = p->pidnext)
+    if(p->pid == pid)
+      break;
+  if(p == 0 || p == myproc() || p->state != RUNNABLE){
+    release(&ptable.lock);
+    return -1;
+  }
+
+  se->sched_class->tick(rq, se, us);
+  if(yield_to_task(rq, se, &p->se) < 0){
+    release(&ptable.lock);
+    return -1;
+  }
+
+  myproc()->state = RUNNABLE;
+  enqueue_task(rq, se);
+  sched();
+  release(&ptable.lock);
+  return 0;
+}
+
 // A fork child's very first scheduling by scheduler()
 // will swtch here.  "Return" to user space.
 void
@@ -471,6 +665,33 @@ forkret(void)
   // Return to "caller", actually trapret (see allocproc).
 }
 
+// Hash p into the sleep queue of p->chan.
+// The ptable lock must be held.
+static void
+chanq_insert(struct proc *p)
+{
+  struct proc **head = &ptable.chanhash[CHANHASH(p->chan)];
+
+  p->qprev = 0;
+  p->qnext = *head;
+  if(*head)
+    (*head)->qprev = p;
+  *head = p;
+}
+
+// Unhash a sleeping p. The ptable lock must be held.
+static void
+chanq_remove(struct proc *p)
+{
+  if(p->qprev)
+    p->qprev->qnext = p->qnext;
+  else
+    ptable.chanhash[CHANHASH(p->chan)] = p->qnext;
+  if(p->qnext)
+    p->qnext->qprev = p->qprev;
+  p->qnext = p->qprev = 0;
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
@@ -496,15 +717,16 @@ sleep(void *chan, struct spinlock *lk)
     release(lk);
   }
   
-  dequeue_entity_fair(&ptable.cfs_rq, se);
+  dequeue_task(&ptable.rq, se);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  chanq_insert(p);
 
   
   if(ALLOW_LOG)
-    cprintf("[SLEEP] pid: %d, nr: %d\n", p->pid, (&ptable.cfs_rq)->nr_running);
+    cprintf("[SLEEP] pid: %d, nr: %d\n", p->pid, ptable.rq.cfs.nr_running);
   
   sched();
 
@@ -521,16 +743,21 @@ sleep(void *chan, struct spinlock *lk)
 //PAGEBREAK!
 // Wake up all processes sleeping on chan.
 // The ptable lock must be held.
+// Only chan's hash bucket is walked; other channels that
+// hash to the same bucket are skipped.
 static void
 wakeup1(void *chan)
 {
-  struct proc *p;
+  struct proc *p, *next;
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+  for(p = ptable.chanhash[CHANHASH(chan)]; p; p = next){
+    next = p->qnext;
     if(p->state == SLEEPING && p->chan == chan) {
+      chanq_remove(p);
       p->state = RUNNABLE;
-      enqueue_entity_fair(&ptable.cfs_rq, &p->se);
+      enqueue_task(&ptable.rq, &p->se);
 	}
+  }
 }
 
 // Wake up all processes sleeping on chan.
@@ -549,19 +776,21 @@ int
 kill(int pid)
 {
   struct proc *p;
-  struct cfs_rq *cfs_rq;
 
   acquire(&ptable.lock);
-  cfs_rq = &ptable.cfs_rq;
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  for(p = ptable.pidhash[PIDHASH(pid)]; p; p = p->pidnext){
     if(p->pid == pid){
+      // Kernel threads never reach user space to die.
+      if(p->kthread)
+        break;
       p->killed = 1;
       // Wake process from sleep if necessary.
       if(p->state == SLEEPING) {
+        chanq_remove(p);
         p->state = RUNNABLE;
 		    struct sched_entity *se = &p->se;
-		    enqueue_entity_fair(cfs_rq, se);
+		    enqueue_task(&ptable.rq, se);
 	  }
       release(&ptable.lock);
       return 0;
@@ -586,14 +815,13 @@ procdump(void)
   [RUNNING]   "run   ",
   [ZOMBIE]    "zombie"
   };
-  int i;
+  int i, h;
   struct proc *p;
   char *state;
   uint pc[10];
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state == UNUSED)
-      continue;
+  for(h = 0; h < NPIDHASH; h++)
+  for(p = ptable.pidhash[h]; p; p = p->pidnext){
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
       state = states[p->state];
     else
@@ -610,10 +838,10 @@ procdump(void)
 
 
 struct proc*
-next_proc(struct cfs_rq *cfs_rq)
+next_proc(struct rq *rq)
 {
   struct sched_entity *nse = 0;
-  nse = pick_entity_fair(cfs_rq);
+  nse = pick_next_task(rq, cpuid());
 
   if(!nse) {
     return 0;
@@ -622,7 +850,7 @@ next_proc(struct cfs_rq *cfs_rq)
   struct proc *np = proc_entry(nse, struct proc, se);
   
   if(np->state != RUNNABLE) {
-    cprintf("NO RUNNABLE: %d, %d, nr: %d\n", np->pid, np->state, cfs_rq->nr_running);
+    cprintf("NO RUNNABLE: %d, %d, nr: %d\n", np->pid, np->state, rq->cfs.nr_running);
     panic("[next_proc] SLEEPING PROC SCHEDULED\n");
     return 0;
   }
@@ -643,24 +871,425 @@ getnice(void)
 int
 setnice(int nice)
 {
+  if(nice < -20 || nice > 19)
+    return 0;
+
   acquire(&ptable.lock);
   struct proc *p = myproc();
-  if (!p) return 0;
   struct sched_entity *se = &p->se;
 
-  dequeue_entity_fair(se->cfs_rq, se);
+  /* The caller is running, so it is not queued: nothing to requeue */
   set_nice_entity(se, nice);
-  enqueue_entity_fair(se->cfs_rq, se);
 
   release(&ptable.lock);
   return 1;
 }
 
 
+// Request a time slice of us microseconds for the caller.
+// Only EEVDF uses it: a shorter slice gives earlier deadlines,
+// a longer one fewer preemptions.
+int
+setslice(int us)
+{
+  if(us < MIN_SLICE_US || us > MAX_SLICE_US)
+    return -1;
+
+  acquire(&ptable.lock);
+  myproc()->se.slice = us;
+  release(&ptable.lock);
+  return 0;
+}
+
+
 int
 forknice(int nice)
 {
   int pid = fork();
 
   return pid;
-}
\ No newline at end of file
+}
+
+
+/* ----- Task groups ----- */
+
+// Look up a live group by id. The ptable lock must be held.
+// Id 0 is the root and has no task_group.
+static struct task_group*
+findgroup(int id)
+{
+  if(id <= 0 || id >= NGROUP || !ptable.tg[id].used)
+    return 0;
+  return &ptable.tg[id];
+}
+
+
+// Create a task group under group parent (0: root).
+// Return the new group's id, or -1.
+int
+tgcreate(int parent)
+{
+  struct task_group *tg, *ptg = 0;
+  int id;
+
+  acquire(&ptable.lock);
+  if(parent != 0 && (ptg = findgroup(parent)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+
+  for(id = 1; id < NGROUP; id++)
+    if(!ptable.tg[id].used)
+      break;
+  if(id == NGROUP){
+    release(&ptable.lock);
+    return -1;
+  }
+
+  tg = &ptable.tg[id];
+  tg->used = 1;
+  tg->id = id;
+  init_task_group(tg, ptg, ptg ? &ptg->cfs_rq : &ptable.rq.cfs);
+
+  release(&ptable.lock);
+  return id;
+}
+
+
+// Move process pid into group id (0: root).
+int
+tgattach(int pid, int id)
+{
+  struct task_group *tg = 0;
+  struct proc *p;
+
+  acquire(&ptable.lock);
+  if(id != 0 && (tg = findgroup(id)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+
+  for(p = ptable.pidhash[PIDHASH(pid)]; p; p = p->pidnext){
+    if(p->pid != pid)
+      continue;
+    if(p->state == EMBRYO || p->state == ZOMBIE)
+      break;
+    move_entity_group(&p->se, tg ? &tg->cfs_rq : &ptable.rq.cfs, tg);
+    release(&ptable.lock);
+    return 0;
+  }
+  release(&ptable.lock);
+  return -1;
+}
+
+
+// Set the CPU shares (weight) of group id.
+int
+tgsetshares(int id, int shares)
+{
+  struct task_group *tg;
+
+  if(shares <= 0)
+    return -1;
+
+  acquire(&ptable.lock);
+  if((tg = findgroup(id)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  set_shares_group(tg, shares);
+  release(&ptable.lock);
+  return 0;
+}
+
+
+// Limit group id to quota us of CPU time per period us.
+// A quota of 0 removes the limit.
+int
+tgsetbandwidth(int id, int quota, int period)
+{
+  struct task_group *tg;
+
+  if(period < MIN_CFS_PERIOD_US || period > MAX_CFS_PERIOD_US)
+    return -1;
+  if(quota < 0 || (quota > 0 && quota < MIN_CFS_PERIOD_US))
+    return -1;
+
+  acquire(&ptable.lock);
+  if((tg = findgroup(id)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  set_bandwidth_group(tg, quota, period, us);
+  if(quota)
+    ptable.next_refill = min(ptable.next_refill, tg->period_end);
+  release(&ptable.lock);
+  return 0;
+}
+
+
+// Start a new bandwidth period for the RT class and for
+// every group whose period has ended, and replenish the
+// deadline tasks whose deadline has come. Called from the timer
+// interrupt; only scans the groups once the earliest period
+// is over.
+void
+bwrefill(u64 now)
+{
+  struct task_group *tg;
+  u64 next = ~0ULL;
+
+  acquire(&ptable.lock);
+  ptable.rq.clock = now;
+  refill_rt_rq(&ptable.rq.rt, now);
+  replenish_dl_rq(&ptable.rq.dl, now);
+  if(now < ptable.next_refill){
+    release(&ptable.lock);
+    return;
+  }
+
+  for(tg = &ptable.tg[1]; tg < &ptable.tg[NGROUP]; tg++){
+    if(!tg->used || !tg->quota)
+      continue;
+    if(now >= tg->period_end)
+      refill_group(tg, now);
+    next = min(next, tg->period_end);
+  }
+  ptable.next_refill = next;
+  release(&ptable.lock);
+}
+
+
+// Copy the statistics of group id to st.
+int
+tgstat(int id, struct tgstat *st)
+{
+  struct task_group *tg;
+  u64 throttled;
+
+  acquire(&ptable.lock);
+  if((tg = findgroup(id)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+
+  throttled = tg->throttled_time;
+  if(tg->throttled)
+    throttled += us - tg->throttled_at;
+
+  st->shares = tg->shares;
+  st->quota_us = tg->quota;
+  st->period_us = tg->period;
+  st->nr_periods = tg->nr_periods;
+  st->nr_throttled = tg->nr_throttled;
+  st->throttled_ms = div_u64(throttled, 1000);
+  st->runtime_ms = div_u64(tg->se.tot_exec_runtime, 1000);
+  st->load_avg = tg->cfs_rq.avg.load_avg;
+  st->util_avg = tg->cfs_rq.avg.util_avg;
+  release(&ptable.lock);
+  return 0;
+}
+
+
+// Copy the load averages of process pid (0: caller), or of
+// the root run queue if pid is -1, to la.
+int
+getloadavg(int pid, struct loadavg *la)
+{
+  struct sched_avg *sa = 0;
+  struct proc *p;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  acquire(&ptable.lock);
+  if(pid == -1)
+    sa = &ptable.rq.cfs.avg;
+  for(p = ptable.pidhash[PIDHASH(pid)]; p && !sa; p = p->pidnext)
+    if(p->pid == pid && p->state != EMBRYO && p->state != ZOMBIE)
+      sa = &p->se.avg;
+  if(sa == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+
+  la->load_avg = sa->load_avg;
+  la->runnable_avg = sa->runnable_avg;
+  la->util_avg = sa->util_avg;
+  release(&ptable.lock);
+  return 0;
+}
+
+
+// Check a policy and its parameters. Return 0 if valid.
+// SCHED_FIFO and SCHED_RR take an RT priority 1..MAX_RT_PRIO-1,
+// the fair policies take 0, SCHED_DEADLINE needs
+// runtime <= deadline <= period.
+static int
+checkattr(struct sched_attr *attr)
+{
+  switch(attr->policy){
+  case SCHED_NORMAL:
+  case SCHED_BATCH:
+  case SCHED_IDLE:
+    return attr->prio == 0 ? 0 : -1;
+  case SCHED_FIFO:
+  case SCHED_RR:
+    return attr->prio >= 1 && attr->prio < MAX_RT_PRIO ? 0 : -1;
+  case SCHED_DEADLINE:
+    if(attr->period == 0)
+      attr->period = attr->deadline;
+    if(attr->runtime < MIN_DL_RUNTIME_US || attr->runtime > attr->deadline ||
+       attr->deadline > attr->period || attr->period > MAX_DL_PERIOD_US)
+      return -1;
+    return 0;
+  }
+  return -1;
+}
+
+
+// Set the scheduling policy and parameters of process pid
+// (0: caller). Fails if a deadline reservation does not fit.
+int
+sched_setattr(int pid, struct sched_attr *uattr)
+{
+  struct sched_attr attr = *uattr;
+  struct proc *p;
+  int r;
+
+  if(checkattr(&attr) < 0)
+    return -1;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  acquire(&ptable.lock);
+  for(p = ptable.pidhash[PIDHASH(pid)]; p; p = p->pidnext){
+    if(p->pid != pid)
+      continue;
+    if(p->state == EMBRYO || p->state == ZOMBIE)
+      break;
+    r = set_policy_entity(&ptable.rq, &p->se, &attr);
+    release(&ptable.lock);
+    return r;
+  }
+  release(&ptable.lock);
+  return -1;
+}
+
+
+// Set the scheduling policy of process pid (0: caller), for
+// the policies that take at most a priority.
+int
+sched_setscheduler(int pid, int policy, int prio)
+{
+  struct sched_attr attr;
+
+  if(policy == SCHED_DEADLINE)
+    return -1;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.policy = policy;
+  attr.prio = prio;
+  return sched_setattr(pid, &attr);
+}
+
+
+// Restrict process pid (0: caller) to the CPUs in mask, bit i
+// standing for CPU i. Bits of absent CPUs are ignored.
+int
+sched_setaffinity(int pid, uint mask)
+{
+  struct proc *p;
+
+  mask &= (1U << ncpu) - 1;
+  if(mask == 0)
+    return -1;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  acquire(&ptable.lock);
+  for(p = ptable.pidhash[PIDHASH(pid)]; p; p = p->pidnext){
+    if(p->pid != pid)
+      continue;
+    if(p->state == EMBRYO || p->state == ZOMBIE)
+      break;
+    set_affinity_entity(&ptable.rq, &p->se, mask);
+    release(&ptable.lock);
+    return 0;
+  }
+  release(&ptable.lock);
+  return -1;
+}
+
+
+// Return the CPU mask of process pid (0: caller).
+int
+sched_getaffinity(int pid)
+{
+  struct proc *p;
+  int mask;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  acquire(&ptable.lock);
+  for(p = ptable.pidhash[PIDHASH(pid)]; p; p = p->pidnext){
+    if(p->pid == pid && p->state != EMBRYO && p->state != ZOMBIE){
+      mask = p->se.cpus_allowed & ((1U << ncpu) - 1);
+      release(&ptable.lock);
+      return mask;
+    }
+  }
+  release(&ptable.lock);
+  return -1;
+}
+
+
+// Copy the scheduler tunables in use to t.
+int
+sched_gettunables(struct sched_tunables *t)
+{
+  acquire(&ptable.lock);
+  *t = sysctl_sched;
+  release(&ptable.lock);
+  return 0;
+}
+
+
+// Replace the scheduler tunables with those in t, all at once.
+int
+sched_settunables(struct sched_tunables *ut)
+{
+  struct sched_tunables t = *ut;
+  int r;
+
+  acquire(&ptable.lock);
+  r = set_sched_tunables(&t);
+  release(&ptable.lock);
+  return r;
+}
+
+
+// Return the scheduling policy of process pid (0: caller).
+int
+sched_getscheduler(int pid)
+{
+  struct proc *p;
+  int policy;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+
+  acquire(&ptable.lock);
+  for(p = ptable.pidhash[PIDHASH(pid)]; p; p = p->pidnext){
+    if(p->pid == pid && p->state != EMBRYO && p->state != ZOMBIE){
+      policy = p->se.policy;
+      release(&ptable.lock);
+      return policy;
+    }
+  }
+  release(&ptable.lock);
+  return -1;
+}
@@ -9,6 +9,10 @@
 
 // Per-CPU state
 struct cpu {
+  // Per-CPU data at %gs:0 and %gs:4 (see seginit), in this order
+  struct cpu *self;            // This struct
+  struct proc *proc;           // The process running on this cpu or null
+
   uchar apicid;                // Local APIC ID
   struct context *scheduler;   // swtch() here to enter scheduler
   //struct cfs_rq cfs_rq;		   // CFS run queue
@@ -18,7 +22,6 @@ struct cpu {
   volatile uint started;       // Has the CPU started?
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
-  struct proc *proc;           // The process running on this cpu or null
 };
 
 extern struct cpu cpus[NCPU];
@@ -51,19 +54,29 @@ struct proc {
 // Per-thread info
   enum procstate state;		   // Process state
   char *kstack;				   // Bottom of kernel stack
+  char *vproc;				   // vDSO page of its own (vdso.h)
+  uint ring;				   // User address of its ring (ring.h), or 0
+  int kthread;				   // Kernel thread: no user memory, never traps out
   struct trapframe *tf;		   // Trap frame for current syscall
   struct context *context;	   // swtch() here to run process
   void *chan;				   // If non-zero, sleeping on chan
+  struct proc *qnext;		   // Next sleeper in chan's hash bucket
+  struct proc *qprev;		   // Previous sleeper in chan's hash bucket
   //uint usp;				   // User stack pointer
 
 // Shared data info
   uint sz;                     // Size of process memory (bytes)
   pde_t* pgdir;                // Page table
   int pid;                     // Process ID
+  struct proc *pidnext;        // Next in pid hash bucket
   struct proc *parent;         // Parent process
+  struct proc *child;          // First child (linked through sibling)
+  struct proc *sibling;        // Next child of the same parent
   int killed;                  // If non-zero, have been killed
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct sleeplock *shared[NSHARED]; // Sleeplocks held shared
+  int nshared;
   char name[16];               // Process name (debugging)
 
 // sched entity info
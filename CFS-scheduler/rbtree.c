@@ -50,6 +50,39 @@ rb_set_parent_color(struct rb_node *node, struct rb_node *p, int color)
 }
 
 
+/*
+ * Augmented tree hooks; aug == 0 for a plain tree
+ * rotate: new took old's place by a rotation
+ * copy:   new took old's place by a deletion
+ * propagate: recompute from node up to (not including) stop
+ */
+static inline void
+rb_augment_rotate(const struct rb_augment_callbacks *aug,
+				  struct rb_node *old, struct rb_node *new)
+{
+  if(aug)
+	aug->rotate(old, new);
+}
+
+
+static inline void
+rb_augment_copy(const struct rb_augment_callbacks *aug,
+				struct rb_node *old, struct rb_node *new)
+{
+  if(aug)
+	aug->copy(old, new);
+}
+
+
+static inline void
+rb_augment_propagate(const struct rb_augment_callbacks *aug,
+					 struct rb_node *node, struct rb_node *stop)
+{
+  if(aug)
+	aug->propagate(node, stop);
+}
+
+
 static inline void
 __rb_rotate_set_parents(struct rb_node *old, struct rb_node *new,
 						struct rb_root *root, int color)
@@ -63,7 +96,8 @@ __rb_rotate_set_parents(struct rb_node *old, struct rb_node *new,
 
 // fixing after insertion by rb-tree condition
 static void
-rb_insert_fix(struct rb_node *node, struct rb_root *root)
+rb_insert_fix(struct rb_node *node, struct rb_root *root,
+			  const struct rb_augment_callbacks *aug)
 {
   struct rb_node *p = rb_red_parent(node);
   struct rb_node *gp, *tmp;
@@ -121,8 +155,7 @@ rb_insert_fix(struct rb_node *node, struct rb_root *root)
 		if(tmp) rb_set_parent_color(tmp, p, RB_BLACK);
 		
 		rb_set_parent_color(p, node, RB_RED);
-		/* dummy rotate? */
-		//rb_set_parent_color(node, gp, RB_RED);
+		rb_augment_rotate(aug, p, node);
 		p = node;
 		tmp = node->rb_right;
 	  }
@@ -139,7 +172,7 @@ rb_insert_fix(struct rb_node *node, struct rb_root *root)
 	  p->rb_right = gp;
 	  if(tmp) rb_set_parent_color(tmp, gp, RB_BLACK);
 	  __rb_rotate_set_parents(gp, p, root, RB_RED);
-	  /* dummy rotate? */
+	  rb_augment_rotate(aug, gp, p);
 	  break;
 	}
 
@@ -162,8 +195,9 @@ rb_insert_fix(struct rb_node *node, struct rb_root *root)
 		// Should block compiler optimization
 		p->rb_left = tmp;
 		node->rb_right = p;
-		if(tmp) rb_set_parent_color(p, node, RB_RED);
-		/* dummy rotate? */
+		if(tmp) rb_set_parent_color(tmp, p, RB_BLACK);
+		rb_set_parent_color(p, node, RB_RED);
+		rb_augment_rotate(aug, p, node);
 		p = node;
 		tmp = node->rb_left;
 	  }
@@ -174,7 +208,7 @@ rb_insert_fix(struct rb_node *node, struct rb_root *root)
 	  p->rb_left = gp;
 	  if(tmp) rb_set_parent_color(tmp, gp, RB_BLACK);
 	  __rb_rotate_set_parents(gp, p, root, RB_RED);
-	  /* dummy rotate? */
+	  rb_augment_rotate(aug, gp, p);
 	  break;
 	}
   }
@@ -185,7 +219,8 @@ rb_insert_fix(struct rb_node *node, struct rb_root *root)
  * node insertion
  */
 static void
-_rb_insert(struct rb_node *node, struct rb_root *root)
+_rb_insert(struct rb_node *node, struct rb_root *root,
+		   const struct rb_augment_callbacks *aug)
 {
   struct rb_node *tmp = root->rb_node;
   if(!tmp) {
@@ -196,7 +231,7 @@ _rb_insert(struct rb_node *node, struct rb_root *root)
   }
 
   struct rb_node *p;
-  uint key = node->key;
+  u64 key = node->key;
 
   while(tmp) {
 	p = tmp;
@@ -214,7 +249,9 @@ _rb_insert(struct rb_node *node, struct rb_root *root)
   rb_set_parent_color(node, p, RB_RED);
   node->rb_left = node->rb_right = 0;
 
-  rb_insert_fix(node, root);
+  /* node's own augmented value is set by the caller */
+  rb_augment_propagate(aug, p, 0);
+  rb_insert_fix(node, root, aug);
 }
 
 
@@ -223,7 +260,8 @@ _rb_insert(struct rb_node *node, struct rb_root *root)
  * default: leftmost successor (smallest bigger)
  */
 static struct rb_node*
-rb_successor(struct rb_node *node, struct rb_root *root)
+rb_successor(struct rb_node *node, struct rb_root *root,
+			 const struct rb_augment_callbacks *aug)
 {
   struct rb_node *child = node->rb_right;
   struct rb_node *tmp = node->rb_left;
@@ -275,7 +313,7 @@ rb_successor(struct rb_node *node, struct rb_root *root)
 	   */
 	  p = successor;
 	  child2 = successor->rb_right;
-	  /* more? */
+	  rb_augment_copy(aug, node, successor);
 	}
 
 	else {
@@ -301,6 +339,8 @@ rb_successor(struct rb_node *node, struct rb_root *root)
 	  p->rb_left = child2;			// c
 	  successor->rb_right = child;	// y
 	  rb_set_parent(child, successor);
+	  rb_augment_copy(aug, node, successor);
+	  rb_augment_propagate(aug, p, successor);
 	}
 
 	tmp = node->rb_left;			// x
@@ -324,6 +364,7 @@ rb_successor(struct rb_node *node, struct rb_root *root)
 	tmp = successor;
   }
 
+  rb_augment_propagate(aug, tmp, 0);
   return rebalance;
 }
 
@@ -331,7 +372,8 @@ rb_successor(struct rb_node *node, struct rb_root *root)
 
 // tree rebalancing after replacing with successor
 static void
-rb_rebalance(struct rb_node *p, struct rb_root *root)
+rb_rebalance(struct rb_node *p, struct rb_root *root,
+			 const struct rb_augment_callbacks *aug)
 {
   struct rb_node *node = 0;
   struct rb_node *sibling, *tmp1, *tmp2;
@@ -361,6 +403,7 @@ rb_rebalance(struct rb_node *p, struct rb_root *root)
 		sibling->rb_left = p;
 		rb_set_parent_color(tmp1, p, RB_BLACK);
 		__rb_rotate_set_parents(p, sibling, root, RB_RED);
+		rb_augment_rotate(aug, p, sibling);
 		sibling = tmp1;
 	  }
 
@@ -406,6 +449,7 @@ rb_rebalance(struct rb_node *p, struct rb_root *root)
 		p->rb_right = tmp2;
 		if(tmp1)
 		  rb_set_parent_color(tmp1, sibling, RB_BLACK);
+		rb_augment_rotate(aug, sibling, tmp2);
 		tmp1 = sibling;
 		sibling = tmp2;
 
@@ -431,6 +475,7 @@ rb_rebalance(struct rb_node *p, struct rb_root *root)
 	  if(tmp2)
 		rb_set_parent(tmp2, p);
 	  __rb_rotate_set_parents(p, sibling, root, RB_BLACK);
+	  rb_augment_rotate(aug, p, sibling);
 	  break;
 	}
 	
@@ -443,6 +488,7 @@ rb_rebalance(struct rb_node *p, struct rb_root *root)
 		sibling->rb_right = p;
 		rb_set_parent_color(tmp1, p, RB_BLACK);
 		__rb_rotate_set_parents(p, sibling, root, RB_RED);
+		rb_augment_rotate(aug, p, sibling);
 		sibling = tmp1;
 	  }
 	  
@@ -464,12 +510,12 @@ rb_rebalance(struct rb_node *p, struct rb_root *root)
 		/* flipped case 3 */
 		tmp1 = tmp2->rb_left;
 		// Shoud block compiler optimization
-		tmp1 = tmp2->rb_left;
 		sibling->rb_right = tmp1;
 		tmp2->rb_left = sibling;
 		p->rb_left = tmp2;
 		if(tmp1)
 		  rb_set_parent_color(tmp1, sibling, RB_BLACK);
+		rb_augment_rotate(aug, sibling, tmp2);
 		tmp1 = sibling;
 		sibling = tmp2;
 	  }
@@ -481,6 +527,7 @@ rb_rebalance(struct rb_node *p, struct rb_root *root)
 	  if(tmp2)
 		rb_set_parent(tmp2, p);
 	  __rb_rotate_set_parents(p, sibling, root, RB_BLACK);
+	  rb_augment_rotate(aug, p, sibling);
 	  break;
 	}
   }
@@ -490,12 +537,13 @@ rb_rebalance(struct rb_node *p, struct rb_root *root)
 
 // node deletion
 static void
-_rb_delete(struct rb_node *node, struct rb_root *root)
+_rb_delete(struct rb_node *node, struct rb_root *root,
+		   const struct rb_augment_callbacks *aug)
 {
   struct rb_node *rebalance;
-  rebalance = rb_successor(node, root);
+  rebalance = rb_successor(node, root, aug);
   if(rebalance)
-	rb_rebalance(rebalance, root);
+	rb_rebalance(rebalance, root, aug);
 }
 
 
@@ -503,13 +551,31 @@ _rb_delete(struct rb_node *node, struct rb_root *root)
 void
 rb_insert(struct rb_node *node, struct rb_root *root)
 {
-  _rb_insert(node, root);
+  _rb_insert(node, root, 0);
 }
 
 void
 rb_delete(struct rb_node *node, struct rb_root *root)
 {
-  _rb_delete(node, root);
+  _rb_delete(node, root, 0);
+}
+
+/*
+ * Augmented variants: each node caches a value computed from its
+ * subtree, kept up to date through aug across rotations
+ */
+void
+rb_insert_augmented(struct rb_node *node, struct rb_root *root,
+					const struct rb_augment_callbacks *aug)
+{
+  _rb_insert(node, root, aug);
+}
+
+void
+rb_delete_augmented(struct rb_node *node, struct rb_root *root,
+					const struct rb_augment_callbacks *aug)
+{
+  _rb_delete(node, root, aug);
 }
 
 struct rb_node*
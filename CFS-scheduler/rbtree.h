@@ -41,4 +41,13 @@ struct rb_root
 };
 
 
+/* Hooks maintaining per-subtree data of an augmented rbtree */
+struct rb_augment_callbacks
+{
+  void (*propagate)(struct rb_node *node, struct rb_node *stop);
+  void (*copy)(struct rb_node *old, struct rb_node *new);
+  void (*rotate)(struct rb_node *old, struct rb_node *new);
+};
+
+
 #endif
@@ -0,0 +1,36 @@
+// Submission and completion rings, for ring_setup() and ring_enter().
+// The process fills sq[] and advances sq_tail; ring_enter() runs
+// the submitted operations in order, each as its system call would,
+// and posts their results in cq[], advancing cq_tail. Indices run
+// freely: entry i is at [i % RING_ENTRIES].
+
+#define RING_ENTRIES    64
+
+#define RING_OP_NOP     0
+#define RING_OP_READ    1   // read(fd, addr, len)
+#define RING_OP_WRITE   2   // write(fd, addr, len)
+#define RING_OP_FSYNC   3   // fsync(fd)
+#define RING_OP_OPEN    4   // open(addr, len), len the mode
+#define RING_OP_CLOSE   5   // close(fd)
+
+struct ring_sqe {
+  uint op;
+  int fd;
+  uint addr;        // buffer, or path for RING_OP_OPEN
+  int len;
+  uint user_data;   // copied to the completion
+};
+
+struct ring_cqe {
+  uint user_data;
+  int res;          // what the system call would have returned
+};
+
+struct ring {
+  volatile uint sq_head;   // advanced by the kernel
+  volatile uint sq_tail;   // advanced by the process
+  volatile uint cq_head;   // advanced by the process
+  volatile uint cq_tail;   // advanced by the kernel
+  struct ring_sqe sq[RING_ENTRIES];
+  struct ring_cqe cq[RING_ENTRIES];
+};
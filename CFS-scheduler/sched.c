@@ -5,11 +5,18 @@
 extern void rb_insert(struct rb_node*, struct rb_root*);
 extern void rb_delete(struct rb_node*, struct rb_root*);
 extern struct rb_node* rb_leftmost(struct rb_root*);
+extern void rb_insert_augmented(struct rb_node*, struct rb_root*,
+                                const struct rb_augment_callbacks*);
+extern void rb_delete_augmented(struct rb_node*, struct rb_root*,
+                                const struct rb_augment_callbacks*);
 
 
 // console.c - to debug
 extern void cprintf(char*, ...);
 
+// trap.c
+extern u64 us;
+
 
 const int prio_to_weight[40] = {
   /* -20 */	88761,	71755,	56483,	46273,	36291,
@@ -40,6 +47,53 @@ const uint prio_to_wmult[40] = {
 };
 
 
+/* ----- Tunables ----- */
+struct sched_tunables sysctl_sched;
+
+/* Tasks that fit in one latency period at min granularity */
+static uint sched_nr_latency;
+
+
+/*
+ * Scale the defaults by 1 + log2(ncpu), ncpu capped at 8, as more
+ * CPUs make each wait shorter anyway
+ */
+void
+init_sched_tunables(int ncpu)
+{
+  uint factor = 1;
+
+  for(ncpu = min(ncpu, 8); ncpu > 1; ncpu >>= 1)
+    factor++;
+
+  sysctl_sched.latency = SCHED_LATENCY_US * factor;
+  sysctl_sched.min_granularity = SCHED_MIN_GRANULARITY * factor;
+  sysctl_sched.wakeup_granularity = SCHED_WAKEUP_GRANULARITY * factor;
+  sysctl_sched.migration_cost = SCHED_MIGRATION_COST;
+  sysctl_sched.log = 0;
+  sched_nr_latency = sysctl_sched.latency / sysctl_sched.min_granularity;
+}
+
+
+/*
+ * Replace all tunables at once; the caller holds the run queue lock
+ * Returns -1, changing nothing, if any is out of range
+ */
+int
+set_sched_tunables(struct sched_tunables *t)
+{
+  if(t->min_granularity < MIN_SLICE_US || t->min_granularity > t->latency ||
+     t->latency > MAX_SCHED_LATENCY_US ||
+     t->wakeup_granularity > t->latency ||
+     t->migration_cost > MAX_SCHED_LATENCY_US || t->log > 1)
+    return -1;
+
+  sysctl_sched = *t;
+  sched_nr_latency = t->latency / t->min_granularity;
+  return 0;
+}
+
+
 /* ----- Load Weight modificatino ----- */
 static void
 update_qinv_weight(struct load_weight *lw)
@@ -53,286 +107,2098 @@ update_qinv_weight(struct load_weight *lw)
 }
 
 
-void
-init_cfs_rq(struct cfs_rq* cfs_rq)
-{
-  cfs_rq->load.nice = 0;
-  cfs_rq->load.weight = 0;
-  cfs_rq->load.inv_weight = 0;
+/* ----- Load tracking ----- */
 
-  cfs_rq->nr_running = 0;
-  cfs_rq->min_vruntime = 0xFFFFFFFF; // 32-bit max uint
-  
-  cfs_rq->curr = 0;
-}
+/* y^n * 2^32, for n < LOAD_AVG_PERIOD */
+static const uint runnable_avg_yN_inv[LOAD_AVG_PERIOD] = {
+  0xffffffff, 0xfa83b2da, 0xf5257d14, 0xefe4b99a, 0xeac0c6e6, 0xe5b906e6,
+  0xe0ccdeeb, 0xdbfbb796, 0xd744fcc9, 0xd2a81d91, 0xce248c14, 0xc9b9bd85,
+  0xc5672a10, 0xc12c4cc9, 0xbd08a39e, 0xb8fbaf46, 0xb504f333, 0xb123f581,
+  0xad583ee9, 0xa9a15ab4, 0xa5fed6a9, 0xa2704302, 0x9ef5325f, 0x9b8d39b9,
+  0x9837f050, 0x94f3efe5, 0x91c0d17d, 0x8e9e2b8a, 0x8b95c1e3, 0x88980e80,
+  0x85aac367, 0x82cd8698,
+};
 
-/* ----- Runqueue modification ----- */
-void
-enqueue_entity_fair(struct cfs_rq *cfs_rq, struct sched_entity *se)
-{
-  if(!se) return;
-  if(se->on_rq) {
-    //cprintf("ENQ Fail: Already in RQ!\n");
-    return;
-  }
 
-  struct rb_root *root = &cfs_rq->proc_timeline;
-  struct rb_node *node = &se->run_node;
+/* val * y^n: halve once per LOAD_AVG_PERIOD, then use the table */
+static u64
+decay_load(u64 val, u64 n)
+{
+  uint mul;
 
-  /* Updates key value right before insert into rbtree */
-  node->key = se->vruntime;
-  rb_insert(node, root);
+  if(unlikely(n > LOAD_AVG_PERIOD * 63))
+    return 0;
 
-  se->on_rq = 1;
-  se->cfs_rq = cfs_rq;
+  val >>= n / LOAD_AVG_PERIOD;
+  mul = runnable_avg_yN_inv[n % LOAD_AVG_PERIOD];
 
-  cfs_rq->nr_running++;
-  cfs_rq->load.weight += se->load.weight;
-  update_qinv_weight(&cfs_rq->load);
-  cfs_rq->leftmost = rb_leftmost(root);
+  /* (val * mul) >> 32, without a 96-bit product */
+  return (((val & 0xFFFFFFFF) * mul) >> 32) + (val >> 32) * mul;
 }
 
 
-void
-dequeue_entity_fair(struct cfs_rq *cfs_rq, struct sched_entity *se)
+/*
+ * Contribution of d1 us ending the oldest period, periods - 1 full
+ * periods, and d3 us of the current one, each decayed to now
+ */
+static uint
+accumulate_segments(u64 periods, uint d1, uint d3)
 {
-  if(!se) return;
-  if(!se->on_rq) {
-    //cprintf("DEQ Fail: Already out of RQ!\n");
-    return;
-  }
-
-  struct rb_root *root = &cfs_rq->proc_timeline;
-  struct rb_node *node = &se->run_node;
+  uint c1, c2;
 
-  rb_delete(node, root);
-  se->on_rq = 0;
-  // keeping cfs_rq data for re-enqueue
-  
-  cfs_rq->nr_running--;
-  cfs_rq->load.weight -= se->load.weight;
-  update_qinv_weight(&cfs_rq->load);
-  cfs_rq->leftmost = rb_leftmost(root);
+  c1 = decay_load(d1, periods);
+  c2 = LOAD_AVG_MAX - decay_load(LOAD_AVG_MAX, periods) - PELT_PERIOD_US;
+  return c1 + c2 + d3;
 }
 
 
-struct sched_entity*
-pick_entity_fair(struct cfs_rq *cfs_rq)
+/*
+ * Add the time since the last update to sa's sums: 'load' times the
+ * runnable time, 'runnable' times the runnable time, and the running
+ * time. Returns whether a period boundary was crossed.
+ */
+static int
+update_load_sum(struct sched_avg *sa, u64 now,
+                uint load, uint runnable, uint running)
 {
-  if(!cfs_rq->nr_running || !cfs_rq->leftmost) 
-	  return 0;
-  
-  struct sched_entity *se = 0;
-  se = se_entry(cfs_rq->leftmost, struct sched_entity, run_node);
+  u64 delta, periods;
+  uint contrib;
+
+  if((long long)(now - sa->last_update_time) <= 0)
+    return 0;
+  delta = now - sa->last_update_time;
+  sa->last_update_time = now;
+
+  if(!load)
+    runnable = running = 0;
+
+  contrib = delta;
+  delta += sa->period_contrib;
+  periods = delta / PELT_PERIOD_US;
+
+  if(periods) {
+    sa->load_sum = decay_load(sa->load_sum, periods);
+    sa->runnable_sum = decay_load(sa->runnable_sum, periods);
+    sa->util_sum = decay_load(sa->util_sum, periods);
+
+    delta %= PELT_PERIOD_US;
+    if(load)
+      contrib = accumulate_segments(periods,
+                                    PELT_PERIOD_US - sa->period_contrib, delta);
+  }
+  sa->period_contrib = delta;
 
-  return se;
+  if(load)
+    sa->load_sum += (u64)load * contrib;
+  if(runnable)
+    sa->runnable_sum += (u64)runnable * contrib << SCHED_CAPACITY_SHIFT;
+  if(running)
+    sa->util_sum += contrib << SCHED_CAPACITY_SHIFT;
+
+  return periods != 0;
 }
 
 
-/* ----- Calculating entity time slice data ----- */
-u64
-calc_period(uint nr_running)
+/* Averages are the sums over the most they could be */
+static void
+update_load_avg(struct sched_avg *sa, uint load)
 {
-  if(unlikely(nr_running > SCHED_NR_LATENCY))
-    return nr_running * SCHED_MIN_GRANULARITY;
-  return SCHED_LATENCY_US;
+  uint divider = LOAD_AVG_MAX - PELT_PERIOD_US + sa->period_contrib;
+
+  sa->load_avg = div_u64((u64)load * sa->load_sum, divider);
+  sa->runnable_avg = div_u64(sa->runnable_sum, divider);
+  sa->util_avg = sa->util_sum / divider;
 }
 
 
-/* Calculate time slice */
-u64
-calc_delta(u64 delta_exec, uint weight, uint q_inv_weight)
+/*
+ * Bring se's averages up to now; se was running since the last
+ * update if 'running', else runnable only while queued
+ */
+static void
+update_entity_avg(struct sched_entity *se, u64 now, uint running)
 {
-  int shift = 32; // WMULT_SHIFT
+  uint runnable = se->on_rq || running;
 
-  u64 mult = (u64)weight * (u64)q_inv_weight;
-  u64 delta = delta_exec * mult;
-  return (delta >> shift);
+  if(update_load_sum(&se->avg, now, runnable, runnable, running))
+    update_load_avg(&se->avg, se->load.weight);
 }
 
 
-u64
-calc_slice(struct cfs_rq *cfs_rq, struct sched_entity *se)
+/*
+ * Bring cfs_rq's averages up to now, from what it held since the
+ * last update: the running entity is off the tree, so it is added
+ */
+static void
+update_cfs_rq_avg(struct cfs_rq *cfs_rq, u64 now)
 {
-  u64 slice = calc_period(cfs_rq->nr_running + !se->on_rq);
-  uint se_weight = se->load.weight;
-  uint q_inv_weight = cfs_rq->load.inv_weight;
+  struct sched_entity *curr = cfs_rq->curr;
+  uint weight = cfs_rq->load.weight;
+  uint nr = cfs_rq->nr_running;
 
-  slice = calc_delta(slice, se_weight, q_inv_weight);
+  if(curr && !curr->on_rq) {
+    weight += curr->load.weight;
+    nr++;
+  }
 
-  if(ALLOW_LOG)
-    cprintf("\nw: %d, qinv: %d => slice: %d\n", se_weight, q_inv_weight, (uint)slice);
-  return slice;
+  if(update_load_sum(&cfs_rq->avg, now, weight, nr, curr != 0))
+    update_load_avg(&cfs_rq->avg, 1);
 }
 
 
-u64
-calc_delta_vslice(u64 delta, struct sched_entity *se)
+/* Averages start out empty, as if idle forever */
+static void
+init_avg(struct sched_avg *sa, u64 now)
 {
-  delta *= (NICE_0_WEIGHT / se->load.weight);
-
-  return delta;
+  sa->last_update_time = now;
+  sa->load_sum = sa->runnable_sum = 0;
+  sa->util_sum = sa->period_contrib = 0;
+  sa->load_avg = sa->runnable_avg = sa->util_avg = 0;
 }
 
 
-/* ----- Updating proc's schedule stats in cfs_rq ----- */
-
 /*
- * Update currently running proc's sched entity data
- * It is called from timer interrupt (every tick) with tick value
+ * A new task has no history: count it as fully runnable, so its
+ * load is not underestimated while it settles, and give it its
+ * weight's share of the queue's utilization, at most half of the
+ * capacity left
  */
-void
-update_entity_stat(struct cfs_rq *cfs_rq, u64 us)
+static void
+init_fork_avg(struct cfs_rq *cfs_rq, struct sched_entity *se, u64 now)
 {
-  struct sched_entity *curr = cfs_rq->curr;
-  if(unlikely(!curr)) return;
+  struct sched_avg *sa = &se->avg;
+  uint divider = LOAD_AVG_MAX - PELT_PERIOD_US;
+  uint util = 0, cap = 0;
+
+  init_avg(sa, now);
+
+  if(cfs_rq->avg.util_avg < SCHED_CAPACITY_SCALE)
+    cap = (SCHED_CAPACITY_SCALE - cfs_rq->avg.util_avg) / 2;
+  if(cfs_rq->avg.util_avg)
+    util = div_u64((u64)cfs_rq->avg.util_avg * se->load.weight,
+                   cfs_rq->avg.load_avg + 1);
+  util = cfs_rq->avg.util_avg ? min(util, cap) : cap;
+
+  sa->load_sum = divider;
+  sa->load_avg = se->load.weight;
+  sa->util_sum = util * divider;
+  sa->util_avg = util;
+  sa->runnable_sum = (u64)util * divider;
+  sa->runnable_avg = util;
+}
 
-  u64 now = us;
-  u64 delta_exec = now - curr->exec_start;
 
-  curr->exec_start = now;
-  //curr->prev_sum_exec_runtime = curr->sum_exec_runtime;
-  curr->sum_exec_runtime += delta_exec;
-  curr->tot_exec_runtime += delta_exec;
-  curr->vruntime += calc_delta_vslice(delta_exec, curr);
+void
+init_cfs_rq(struct cfs_rq* cfs_rq)
+{
+  cfs_rq->load.nice = 0;
+  cfs_rq->load.weight = 0;
+  cfs_rq->load.inv_weight = 0;
+
+  cfs_rq->nr_running = 0;
+  cfs_rq->idle_nr_running = 0;
+  cfs_rq->min_vruntime = 0xFFFFFFFF; // 32-bit max uint
   
-  // update run_node's key - [NEED TO CHECK]
-  struct rb_node *run_node = &curr->run_node;
-  run_node->key = curr->vruntime;
+  cfs_rq->proc_timeline.rb_node = 0;
+  cfs_rq->leftmost = 0;
+  cfs_rq->curr = 0;
+  cfs_rq->next = 0;
+  cfs_rq->tg = 0;
 
-  update_min_vruntime(cfs_rq);
+  cfs_rq->avg_vruntime = 0;
+  cfs_rq->avg_load = 0;
+
+  init_avg(&cfs_rq->avg, us);
 }
 
 
+/* ----- Timeline augmentation ----- */
+
 /*
- * Update min_vruntime of cfs_rq, from current se and leftmost se
- * New min_vruntime is the min(curr, leftmost)
- * Since time passed, choose max(cfs_rq->min_vruntime, new min_vruntime)
+ * The timeline stays sorted by vruntime; each node also caches,
+ * for its subtree, the earliest deadline (EEVDF) and the CPUs some
+ * entity may run on (affinity), so both searches are O(log n)
  */
-void
-update_min_vruntime(struct cfs_rq *cfs_rq)
+# define run_entry(n)	rb_entry(n, struct sched_entity, run_node)
+
+static void
+run_subtree(struct sched_entity *se, u64 *min_deadline, uint *cpus)
 {
-  struct sched_entity *curr = cfs_rq->curr;
-  struct rb_node *leftmost = cfs_rq->leftmost;
-  u64 vruntime = cfs_rq->min_vruntime;
-  u64 new_min = vruntime;
+  struct rb_node *child;
 
-  if(curr)
-    new_min = curr->vruntime;
-  if(leftmost) {
-    struct sched_entity *se = rb_entry(leftmost, struct sched_entity, run_node);
-    new_min = min(new_min, se->vruntime);
+  *min_deadline = se->deadline;
+  *cpus = se->cpus_allowed;
+
+  if((child = se->run_node.rb_left) != 0) {
+    *min_deadline = min(*min_deadline, run_entry(child)->min_deadline);
+    *cpus |= run_entry(child)->subtree_cpus;
+  }
+  if((child = se->run_node.rb_right) != 0) {
+    *min_deadline = min(*min_deadline, run_entry(child)->min_deadline);
+    *cpus |= run_entry(child)->subtree_cpus;
   }
+}
 
-  cfs_rq->min_vruntime = max(vruntime, new_min);
 
-  return;
+static void
+run_propagate(struct rb_node *node, struct rb_node *stop)
+{
+  u64 min_deadline;
+  uint cpus;
+
+  while(node != stop) {
+    struct sched_entity *se = run_entry(node);
+
+    run_subtree(se, &min_deadline, &cpus);
+    if(se->min_deadline == min_deadline && se->subtree_cpus == cpus)
+      break;
+    se->min_deadline = min_deadline;
+    se->subtree_cpus = cpus;
+    node = rb_parent(node);
+  }
 }
 
 
-/* ----- Stage to judge/prepare for yield() ----- */
-int
-check_yield(struct cfs_rq *cfs_rq)
+static void
+run_copy(struct rb_node *old, struct rb_node *new)
 {
-  /* If yield condition true ? 1 : 0 */
+  run_entry(new)->min_deadline = run_entry(old)->min_deadline;
+  run_entry(new)->subtree_cpus = run_entry(old)->subtree_cpus;
+}
 
-  struct sched_entity *curr = cfs_rq->curr;
-  u64 runtime = curr->sum_exec_runtime;
 
-  /* Ensure the min granularity */
-  if(runtime < SCHED_MIN_GRANULARITY)
-	  return 0;
+static void
+run_rotate(struct rb_node *old, struct rb_node *new)
+{
+  struct sched_entity *ose = run_entry(old);
 
-  u64 ideal_runtime = calc_slice(cfs_rq, curr);
+  run_copy(old, new);
+  run_subtree(ose, &ose->min_deadline, &ose->subtree_cpus);
+}
 
-  if(ALLOW_LOG) {
-    cprintf("runtime: %d, ideal: %d\n", (uint)runtime, (uint)ideal_runtime);
-    cprintf("vruntime: %d, nr: %d\n", (uint)curr->vruntime, cfs_rq->nr_running);
-  }
 
-  /* if runtime over ideal runtime, yield */
-  if(runtime >= ideal_runtime) {
-    if(ALLOW_LOG) cprintf("[OVER IDEAL RUNTIME]\n");
-	  return 1;
-  }
+static const struct rb_augment_callbacks run_cb = {
+  .propagate  = run_propagate,
+  .copy       = run_copy,
+  .rotate     = run_rotate,
+};
 
-  struct sched_entity *leftmost = pick_entity_fair(cfs_rq);
-  signed long long delta_vruntime = (u64)curr->vruntime - (u64)leftmost->vruntime;
 
-  /* if leftmost vruntime is smaller, yield */
-  if(delta_vruntime > 0) {
-    if(ALLOW_LOG) cprintf("[SMALLER VRUNTIME FOUND]: %d\n", (uint)leftmost->vruntime);
-	  return 1;
-  }
+static inline int
+cpu_allowed(struct sched_entity *se, int cpu)
+{
+  return (se->cpus_allowed >> cpu) & 1;
+}
 
-  //if(delta_vruntime > ideal_runtime)
-	//return 1;
-  return 0;
+
+/* Leftmost entity of cfs_rq allowed on cpu */
+static struct sched_entity*
+first_entity_cpu(struct cfs_rq *cfs_rq, int cpu)
+{
+  struct rb_node *node = cfs_rq->proc_timeline.rb_node;
+  struct rb_node *left;
+
+  if(!node || !((run_entry(node)->subtree_cpus >> cpu) & 1))
+    return 0;
+
+  /* Some entity below node is allowed: find the leftmost one */
+  for(;;) {
+    left = node->rb_left;
+    if(left && ((run_entry(left)->subtree_cpus >> cpu) & 1))
+      node = left;
+    else if(cpu_allowed(run_entry(node), cpu))
+      return run_entry(node);
+    else
+      node = node->rb_right;
+  }
 }
 
 
-/* ----- sched_entity modification ----- */
-void
-init_entity(struct sched_entity *se)
+/*
+ * A group can run on the CPUs of its queued members
+ * After cfs_rq's tree changed, update its group's mask, and the
+ * masks cached above the group's entity, up the hierarchy
+ */
+static void
+update_group_cpus(struct cfs_rq *cfs_rq)
 {
-  se->on_rq = 0;
+  struct sched_entity *gse;
+  struct rb_node *root;
+  uint cpus;
+
+  for(; cfs_rq->tg; cfs_rq = gse->cfs_rq) {
+    gse = &cfs_rq->tg->se;
+    root = cfs_rq->proc_timeline.rb_node;
+    cpus = root ? run_entry(root)->subtree_cpus : 0;
+
+    if(gse->cpus_allowed == cpus)
+      break;
+    gse->cpus_allowed = cpus;
+    if(gse->on_rq)
+      run_propagate(&gse->run_node, 0);
+  }
+}
 
-  // Default nice : 20
-  se->load.nice = 0;
-  se->load.weight = prio_to_weight[0+20];
-  se->load.inv_weight = prio_to_wmult[0+20];
 
-  se->run_node.__rb_parent_color = 0;
-  se->run_node.rb_right = 0;
-  se->run_node.rb_left = 0;
+/* ----- EEVDF ----- */
 
-  se->exec_start = 0;
-  se->sum_exec_runtime = 0;
-  se->vruntime = 0;
-  se->tot_exec_runtime = 0;
+
+/* vruntime relative to min_vruntime, as summed in avg_vruntime */
+static inline long long
+entity_key(struct cfs_rq *cfs_rq, u64 vruntime)
+{
+  return (long long)(vruntime - cfs_rq->min_vruntime);
 }
 
 
-void
-copy_entity(struct sched_entity *pse, struct sched_entity *cse)
+static void
+avg_vruntime_add(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
-  struct cfs_rq *cfs_rq = pse->cfs_rq;
-  cse->on_rq = 0;
+  cfs_rq->avg_vruntime += entity_key(cfs_rq, se->run_node.key) * se->load.weight;
+  cfs_rq->avg_load += se->load.weight;
+}
 
-  cse->load.nice = pse->load.nice;
-  cse->load.weight = pse->load.weight;
-  cse->load.inv_weight = pse->load.inv_weight;
-  cse->cfs_rq = cfs_rq; // affinity?
 
-  // Execute forked-child first
-  cse->exec_start = 0;
-  cse->sum_exec_runtime = 0;
-  cse->vruntime = cfs_rq->min_vruntime;
-  cse->tot_exec_runtime = 0;
+static void
+avg_vruntime_sub(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+  cfs_rq->avg_vruntime -= entity_key(cfs_rq, se->run_node.key) * se->load.weight;
+  cfs_rq->avg_load -= se->load.weight;
 }
 
 
-void
-reset_entity(struct sched_entity *se, u64 us)
+/*
+ * Load-weighted average vruntime of the queue, the zero-lag point
+ * The running entity is off the tree, so it is added here
+ */
+u64
+avg_vruntime(struct cfs_rq *cfs_rq)
 {
-  // set exec_start as current time
-  // clear sum_exec_runtime of entity
-  se->exec_start = us;
-  se->sum_exec_runtime = 0;
+  struct sched_entity *curr = cfs_rq->curr;
+  long long avg = cfs_rq->avg_vruntime;
+  uint load = cfs_rq->avg_load;
+
+  if(curr && !curr->on_rq) {
+    avg += entity_key(cfs_rq, curr->vruntime) * curr->load.weight;
+    load += curr->load.weight;
+  }
+
+  if(load) {
+    /* Round down, so no eligible entity is right of the average */
+    if(avg < 0)
+      avg -= load - 1;
+    avg = div_s64(avg, load);
+  }
+  return cfs_rq->min_vruntime + avg;
 }
 
 
+/*
+ * se is eligible if it has not received more than its share:
+ * vruntime <= avg_vruntime, compared without dividing
+ */
 int
-get_nice_entity(struct sched_entity *se)
+entity_eligible(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
-  return se->load.nice;
+  struct sched_entity *curr = cfs_rq->curr;
+  long long avg = cfs_rq->avg_vruntime;
+  uint load = cfs_rq->avg_load;
+
+  if(curr && !curr->on_rq) {
+    avg += entity_key(cfs_rq, curr->vruntime) * curr->load.weight;
+    load += curr->load.weight;
+  }
+  return avg >= entity_key(cfs_rq, se->vruntime) * (long long)load;
 }
 
 
-void
-set_nice_entity(struct sched_entity *se, int nice)
+/*
+ * Earliest eligible virtual deadline first
+ * Eligible entities are a prefix of the vruntime order, so walk
+ * down: go left past ineligible nodes, and remember the eligible
+ * left subtree with the earliest min_deadline on the way
+ * The running entity is off the tree; it competes only if passed
+ * as curr, which only the yield check does: scheduler() must not
+ * pick what another CPU is running
+ */
+struct sched_entity*
+pick_eevdf(struct cfs_rq *cfs_rq, struct sched_entity *curr)
+{
+  struct rb_node *node = cfs_rq->proc_timeline.rb_node;
+  struct sched_entity *best = 0, *best_left = 0, *se;
+
+  if(curr && entity_eligible(cfs_rq, curr))
+    best = curr;
+
+  while(node) {
+    se = rb_entry(node, struct sched_entity, run_node);
+
+    if(!entity_eligible(cfs_rq, se)) {
+      node = node->rb_left;
+      continue;
+    }
+
+    if(!best || (long long)(se->deadline - best->deadline) < 0)
+      best = se;
+
+    /* Everything left of an eligible node is eligible too */
+    if(node->rb_left) {
+      struct sched_entity *left = rb_entry(node->rb_left, struct sched_entity, run_node);
+
+      if(!best_left || (long long)(left->min_deadline - best_left->min_deadline) < 0)
+        best_left = left;
+      /* The subtree's earliest deadline is on the left */
+      if(left->min_deadline == se->min_deadline)
+        break;
+    }
+
+    if(se->min_deadline == se->deadline)
+      break;
+    node = node->rb_right;
+  }
+
+  if(!best_left || (best && (long long)(best_left->min_deadline - best->deadline) >= 0))
+    goto found;
+
+  /* The earliest deadline is in best_left's subtree: follow it */
+  for(node = &best_left->run_node; node; ) {
+    se = rb_entry(node, struct sched_entity, run_node);
+    if(se->deadline == se->min_deadline) {
+      best = se;
+      break;
+    }
+    if(node->rb_left &&
+       rb_entry(node->rb_left, struct sched_entity, run_node)->min_deadline == se->min_deadline)
+      node = node->rb_left;
+    else
+      node = node->rb_right;
+  }
+
+found:
+  /* Rounding aside, the leftmost entity is always eligible */
+  if(!best && cfs_rq->leftmost)
+    best = rb_entry(cfs_rq->leftmost, struct sched_entity, run_node);
+  return best;
+}
+
+
+/* Once se has run past its deadline, it asks for its next slice */
+static void
+update_deadline(struct sched_entity *se)
+{
+  if((long long)(se->vruntime - se->deadline) < 0)
+    return;
+  se->deadline = se->vruntime + calc_delta_vslice(se->slice, se);
+}
+
+
+/* se leaves the queue: remember how far it is from the average */
+static void
+save_lag(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+  long long limit = calc_delta_vslice(2 * se->slice, se);
+  long long lag = (long long)(avg_vruntime(cfs_rq) - se->vruntime);
+
+  se->vlag = max(min(lag, limit), -limit);
+  se->lag_saved = 1;
+}
+
+
+/*
+ * se joins the queue: put it at the saved lag from the average
+ * Adding se moves the average towards it by lag * w / (W + w),
+ * so the lag is scaled up first to stay what it was
+ */
+static void
+place_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+  struct sched_entity *curr = cfs_rq->curr;
+  u64 vruntime = avg_vruntime(cfs_rq);
+  long long lag = se->vlag;
+  uint load = cfs_rq->avg_load;
+
+  if(curr && !curr->on_rq)
+    load += curr->load.weight;
+  if(load)
+    lag = div_s64(lag * (load + se->load.weight), load);
+  if(lag > 0 && (u64)lag > vruntime)
+    lag = vruntime;
+
+  se->vruntime = vruntime - lag;
+  se->deadline = se->vruntime + calc_delta_vslice(se->slice, se);
+  se->lag_saved = 0;
+}
+
+
+static void
+timeline_insert(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+  se->min_deadline = se->deadline;
+  se->subtree_cpus = se->cpus_allowed;
+  rb_insert_augmented(&se->run_node, &cfs_rq->proc_timeline, &run_cb);
+  if(SCHED_EEVDF)
+    avg_vruntime_add(cfs_rq, se);
+  update_group_cpus(cfs_rq);
+}
+
+
+static void
+timeline_delete(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+  rb_delete_augmented(&se->run_node, &cfs_rq->proc_timeline, &run_cb);
+  if(SCHED_EEVDF)
+    avg_vruntime_sub(cfs_rq, se);
+  update_group_cpus(cfs_rq);
+}
+
+/* ----- Runqueue modification ----- */
+void
+enqueue_entity_fair(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+  if(!se) return;
+  if(se->on_rq) {
+    //cprintf("ENQ Fail: Already in RQ!\n");
+    return;
+  }
+
+  struct rb_root *root = &cfs_rq->proc_timeline;
+  struct rb_node *node = &se->run_node;
+
+  /* Close the averages' running or sleeping stretch */
+  update_entity_avg(se, us, cfs_rq->curr == se);
+  update_cfs_rq_avg(cfs_rq, us);
+
+  /* Updates key value right before insert into rbtree */
+  node->key = se->vruntime;
+  timeline_insert(cfs_rq, se);
+
+  se->on_rq = 1;
+  se->cfs_rq = cfs_rq;
+
+  cfs_rq->nr_running++;
+  if(se->policy == SCHED_IDLE)
+    cfs_rq->idle_nr_running++;
+  cfs_rq->load.weight += se->load.weight;
+  update_qinv_weight(&cfs_rq->load);
+  cfs_rq->leftmost = rb_leftmost(root);
+
+  /* First runnable member: the group becomes runnable in its parent */
+  if(cfs_rq->tg && cfs_rq->nr_running == 1 && !cfs_rq->tg->throttled) {
+    struct sched_entity *gse = &cfs_rq->tg->se;
+    /* Don't let an idle group come back with a stale, tiny vruntime */
+    gse->vruntime = max(gse->vruntime, gse->cfs_rq->min_vruntime);
+    if(SCHED_EEVDF)
+      update_deadline(gse);
+    enqueue_entity_fair(gse->cfs_rq, gse);
+  }
+}
+
+
+void
+dequeue_entity_fair(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+  if(!se) return;
+  if(!se->on_rq) {
+    //cprintf("DEQ Fail: Already out of RQ!\n");
+    return;
+  }
+
+  struct rb_root *root = &cfs_rq->proc_timeline;
+
+  update_entity_avg(se, us, 0);
+  update_cfs_rq_avg(cfs_rq, us);
+
+  if(cfs_rq->next == se)
+    cfs_rq->next = 0;
+  timeline_delete(cfs_rq, se);
+  se->on_rq = 0;
+  // keeping cfs_rq data for re-enqueue
+  
+  cfs_rq->nr_running--;
+  if(se->policy == SCHED_IDLE)
+    cfs_rq->idle_nr_running--;
+  cfs_rq->load.weight -= se->load.weight;
+  update_qinv_weight(&cfs_rq->load);
+  cfs_rq->leftmost = rb_leftmost(root);
+
+  /* Last runnable member gone: take the group off its parent */
+  if(cfs_rq->tg && cfs_rq->nr_running == 0)
+    dequeue_entity_fair(cfs_rq->tg->se.cfs_rq, &cfs_rq->tg->se);
+}
+
+
+/*
+ * Re-sort an entity in its queue after its vruntime changed
+ */
+static void
+requeue_entity_fair(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+  struct rb_root *root = &cfs_rq->proc_timeline;
+  struct rb_node *node = &se->run_node;
+
+  timeline_delete(cfs_rq, se);
+  node->key = se->vruntime;
+  timeline_insert(cfs_rq, se);
+  cfs_rq->leftmost = rb_leftmost(root);
+}
+
+
+/*
+ * Entity of cfs_rq to run next on cpu
+ * The next buddy goes first if that is fair enough: if it is
+ * eligible under EEVDF, or else if it trails the leftmost entity by
+ * at most the wakeup granularity
+ * Under EEVDF, if the EEVDF pick may not run on cpu, the leftmost
+ * entity that may is taken instead
+ */
+struct sched_entity*
+pick_entity_fair(struct cfs_rq *cfs_rq, int cpu)
+{
+  if(!cfs_rq->nr_running || !cfs_rq->leftmost) 
+	  return 0;
+  
+  struct sched_entity *se = 0;
+  struct sched_entity *next = cfs_rq->next;
+
+  if(next && !cpu_allowed(next, cpu))
+    next = 0;
+
+  if(SCHED_EEVDF) {
+    if(next && entity_eligible(cfs_rq, next))
+      return next;
+    se = pick_eevdf(cfs_rq, 0);
+    if(se && cpu_allowed(se, cpu))
+      return se;
+  }
+
+  se = se_entry(cfs_rq->leftmost, struct sched_entity, run_node);
+  if(!cpu_allowed(se, cpu))
+    se = first_entity_cpu(cfs_rq, cpu);
+
+  if(!SCHED_EEVDF && next && se &&
+     (long long)(next->vruntime - se->vruntime) <=
+     (long long)calc_delta_vslice(sysctl_sched.wakeup_granularity, se))
+    return next;
+  return se;
+}
+
+
+/*
+ * Pick the process entity to run next on cpu
+ * Walk down from cfs_rq, taking the leftmost entity at each level
+ */
+struct sched_entity*
+pick_next_entity_fair(struct cfs_rq *cfs_rq, int cpu)
+{
+  struct sched_entity *se = pick_entity_fair(cfs_rq, cpu);
+
+  while(se && se->my_q)
+    se = pick_entity_fair(se->my_q, cpu);
+
+  return se;
+}
+
+
+/*
+ * se starts running: take it off its queue and
+ * mark it, and every group above it, as current
+ */
+void
+set_curr_entity_fair(struct sched_entity *se)
+{
+  dequeue_entity_fair(se->cfs_rq, se);
+  for(; se; se = se->parent) {
+    se->cfs_rq->curr = se;
+    if(se->cfs_rq->next == se)
+      se->cfs_rq->next = 0;
+  }
+}
+
+
+/*
+ * se stopped running: clear it and its groups as current
+ */
+void
+put_curr_entity_fair(struct sched_entity *se)
+{
+  for(; se; se = se->parent)
+    if(se->cfs_rq->curr == se) {
+      update_entity_avg(se, us, 1);
+      update_cfs_rq_avg(se->cfs_rq, us);
+      se->cfs_rq->curr = 0;
+    }
+}
+
+
+/* ----- Calculating entity time slice data ----- */
+u64
+calc_period(uint nr_running)
+{
+  if(unlikely(nr_running > sched_nr_latency))
+    return (u64)nr_running * sysctl_sched.min_granularity;
+  return sysctl_sched.latency;
+}
+
+
+/* Calculate time slice */
+u64
+calc_delta(u64 delta_exec, uint weight, uint q_inv_weight)
+{
+  int shift = 32; // WMULT_SHIFT
+
+  u64 mult = (u64)weight * (u64)q_inv_weight;
+  u64 delta = delta_exec * mult;
+  return (delta >> shift);
+}
+
+
+/*
+ * The period is split by weight at every level of the hierarchy:
+ * a process gets its share of its group's share of the period
+ * A running entity is off its queue, so its own weight is added
+ * SCHED_BATCH trades latency for fewer switches: a longer slice
+ */
+u64
+calc_slice(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+  u64 slice = calc_period(cfs_rq->nr_running + !se->on_rq);
+  int batch = se->policy == SCHED_BATCH;
+
+  for(; se; se = se->parent) {
+    struct cfs_rq *q = se->cfs_rq;
+    uint se_weight = se->load.weight;
+    uint q_weight = q->load.weight + (se->on_rq ? 0 : se_weight);
+    uint q_inv_weight = WMULT_CONST / q_weight;
+
+    slice = calc_delta(slice, se_weight, q_inv_weight);
+
+    if(ALLOW_LOG)
+      cprintf("\nw: %d, qinv: %d => slice: %d\n", se_weight, q_inv_weight, (uint)slice);
+  }
+
+  if(batch)
+    slice = max(slice, SCHED_BATCH_GRANULARITY);
+  return slice;
+}
+
+
+/* Batch and idle entities don't preempt the running one when they wake */
+static inline int
+wakeup_preempts(struct sched_entity *se)
+{
+  return se->policy != SCHED_BATCH && se->policy != SCHED_IDLE;
+}
+
+
+/* Scale real runtime to virtual runtime: delta * NICE_0_WEIGHT / weight */
+u64
+calc_delta_vslice(u64 delta, struct sched_entity *se)
+{
+  return calc_delta(delta, NICE_0_WEIGHT, se->load.inv_weight);
+}
+
+
+/* ----- Bandwidth control ----- */
+
+/* Take tg off its parent queue until its next refill */
+static void
+throttle_group(struct task_group *tg, u64 now)
+{
+  tg->throttled = 1;
+  tg->throttled_at = now;
+  tg->nr_throttled++;
+
+  dequeue_entity_fair(tg->se.cfs_rq, &tg->se);
+}
+
+
+/* Charge delta_exec to tg's quota, throttling it once exhausted */
+static void
+account_group_runtime(struct task_group *tg, u64 delta_exec, u64 now)
+{
+  if(!tg->quota)
+    return;
+
+  tg->runtime_remaining -= delta_exec;
+  if(tg->runtime_remaining <= 0 && !tg->throttled)
+    throttle_group(tg, now);
+}
+
+
+/* Put a throttled tg back on its parent queue */
+static void
+unthrottle_group(struct task_group *tg, u64 now)
+{
+  tg->throttled = 0;
+  tg->throttled_time += now - tg->throttled_at;
+
+  if(tg->cfs_rq.nr_running) {
+    struct sched_entity *gse = &tg->se;
+    gse->vruntime = max(gse->vruntime, gse->cfs_rq->min_vruntime);
+    if(SCHED_EEVDF)
+      update_deadline(gse);
+    enqueue_entity_fair(gse->cfs_rq, gse);
+  }
+}
+
+
+/*
+ * Start a new bandwidth period for tg
+ * Overrun of the last period is paid back first; if runtime is
+ * left afterwards, a throttled group is put back on its parent
+ */
+void
+refill_group(struct task_group *tg, u64 now)
+{
+  tg->nr_periods++;
+  tg->period_end = now + tg->period;
+  tg->runtime_remaining = min(tg->runtime_remaining + (long long)tg->quota,
+                              (long long)tg->quota);
+
+  if(tg->throttled && tg->runtime_remaining > 0)
+    unthrottle_group(tg, now);
+}
+
+
+/* Is se, or any group above it, throttled? */
+int
+throttled_entity(struct sched_entity *se)
+{
+  for(; se; se = se->parent)
+    if(se->cfs_rq->tg && se->cfs_rq->tg->throttled)
+      return 1;
+  return 0;
+}
+
+
+/* ----- Updating proc's schedule stats in cfs_rq ----- */
+
+/*
+ * Update currently running proc's sched entity data
+ * It is called from timer interrupt (every tick) with tick value
+ * The runtime is charged to curr and to every group entity above
+ * it, each scaled by that entity's own weight
+ */
+void
+update_entity_stat(struct sched_entity *curr, u64 us)
+{
+  if(unlikely(!curr)) return;
+
+  u64 now = us;
+  u64 delta_exec = now - curr->exec_start;
+  struct sched_entity *se;
+
+  curr->exec_start = now;
+  //curr->prev_sum_exec_runtime = curr->sum_exec_runtime;
+  curr->sum_exec_runtime += delta_exec;
+  curr->tot_exec_runtime += delta_exec;
+
+  for(se = curr; se; se = se->parent) {
+    update_entity_avg(se, now, 1);
+    update_cfs_rq_avg(se->cfs_rq, now);
+
+    if(se != curr)
+      se->tot_exec_runtime += delta_exec;
+    se->vruntime += calc_delta_vslice(delta_exec, se);
+    if(SCHED_EEVDF)
+      update_deadline(se);
+
+    /* A group entity may still be queued for other members */
+    if(se->on_rq)
+      requeue_entity_fair(se->cfs_rq, se);
+    else
+      se->run_node.key = se->vruntime;
+
+    update_min_vruntime(se->cfs_rq);
+
+    if(se->my_q)
+      account_group_runtime(se->my_q->tg, delta_exec, now);
+  }
+}
+
+
+/*
+ * Update min_vruntime of cfs_rq, from current se and leftmost se
+ * New min_vruntime is the min(curr, leftmost)
+ * Since time passed, choose max(cfs_rq->min_vruntime, new min_vruntime)
+ */
+void
+update_min_vruntime(struct cfs_rq *cfs_rq)
+{
+  struct sched_entity *curr = cfs_rq->curr;
+  struct rb_node *leftmost = cfs_rq->leftmost;
+  u64 vruntime = cfs_rq->min_vruntime;
+  u64 new_min = vruntime;
+
+  if(curr)
+    new_min = curr->vruntime;
+  if(leftmost) {
+    struct sched_entity *se = rb_entry(leftmost, struct sched_entity, run_node);
+    new_min = min(new_min, se->vruntime);
+  }
+
+  cfs_rq->min_vruntime = max(vruntime, new_min);
+
+  /* avg_vruntime is kept relative to min_vruntime */
+  if(SCHED_EEVDF)
+    cfs_rq->avg_vruntime -= (long long)cfs_rq->avg_load *
+                            (long long)(cfs_rq->min_vruntime - vruntime);
+
+  return;
+}
+
+
+/* ----- Stage to judge/prepare for yield() ----- */
+int
+check_yield(struct sched_entity *curr)
+{
+  /* If yield condition true ? 1 : 0 */
+
+  struct cfs_rq *cfs_rq = curr->cfs_rq;
+  struct sched_entity *se, *leftmost;
+  u64 runtime = curr->sum_exec_runtime;
+
+  /* A throttled group must stop at once */
+  if(throttled_entity(curr))
+    return 1;
+
+  /* SCHED_IDLE gives way to anything else runnable beside it */
+  if(curr->policy == SCHED_IDLE && cfs_rq->nr_running > cfs_rq->idle_nr_running)
+    return 1;
+
+  /*
+   * EEVDF: run out the requested slice, unless an eligible entity
+   * with an earlier deadline turns up at some level
+   */
+  if(SCHED_EEVDF) {
+    u64 slice = curr->slice;
+    if(curr->policy == SCHED_BATCH)
+      slice = max(slice, SCHED_BATCH_GRANULARITY);
+    if(runtime >= slice)
+      return 1;
+    for(se = curr; se; se = se->parent) {
+      leftmost = pick_eevdf(se->cfs_rq, se);
+      if(leftmost && leftmost != se && wakeup_preempts(leftmost) &&
+         cpu_allowed(leftmost, curr->cpu) &&
+         (long long)(leftmost->deadline - se->deadline) < 0)
+        return 1;
+    }
+    return 0;
+  }
+
+  /* Ensure the min granularity */
+  if(runtime < (curr->policy == SCHED_BATCH ? SCHED_BATCH_GRANULARITY
+                                            : sysctl_sched.min_granularity))
+	  return 0;
+
+  u64 ideal_runtime = calc_slice(cfs_rq, curr);
+
+  if(ALLOW_LOG) {
+    cprintf("runtime: %d, ideal: %d\n", (uint)runtime, (uint)ideal_runtime);
+    cprintf("vruntime: %d, nr: %d\n", (uint)curr->vruntime, cfs_rq->nr_running);
+  }
+
+  /* if runtime over ideal runtime, yield */
+  if(runtime >= ideal_runtime) {
+    if(ALLOW_LOG) cprintf("[OVER IDEAL RUNTIME]\n");
+	  return 1;
+  }
+
+  /*
+   * if leftmost vruntime is smaller at any level by more than the
+   * wakeup granularity, in leftmost's virtual time, yield
+   */
+  for(se = curr; se; se = se->parent) {
+    leftmost = pick_entity_fair(se->cfs_rq, curr->cpu);
+    if(!leftmost || leftmost == se || !wakeup_preempts(leftmost))
+      continue;
+
+    /* A buddy is only picked when it is fair enough */
+    if(leftmost == se->cfs_rq->next)
+      return 1;
+
+    signed long long delta_vruntime = (u64)se->vruntime - (u64)leftmost->vruntime;
+    if(delta_vruntime > (long long)calc_delta_vslice(sysctl_sched.wakeup_granularity,
+                                                     leftmost)) {
+      if(ALLOW_LOG) cprintf("[SMALLER VRUNTIME FOUND]: %d\n", (uint)leftmost->vruntime);
+	    return 1;
+    }
+  }
+
+  //if(delta_vruntime > ideal_runtime)
+	//return 1;
+  return 0;
+}
+
+
+/* ----- sched_entity modification ----- */
+void
+init_entity(struct sched_entity *se)
+{
+  se->on_rq = 0;
+
+  // Default nice : 20
+  se->load.nice = 0;
+  se->load.weight = prio_to_weight[0+20];
+  se->load.inv_weight = prio_to_wmult[0+20];
+
+  se->run_node.__rb_parent_color = 0;
+  se->run_node.rb_right = 0;
+  se->run_node.rb_left = 0;
+
+  se->exec_start = 0;
+  se->sum_exec_runtime = 0;
+  se->vruntime = 0;
+  se->tot_exec_runtime = 0;
+
+  se->deadline = 0;
+  se->min_deadline = 0;
+  se->slice = SCHED_BASE_SLICE_US;
+  se->vlag = 0;
+  se->lag_saved = 1;
+
+  se->cpus_allowed = CPU_MASK_ALL;
+  se->subtree_cpus = 0;
+  se->cpu = 0;
+
+  se->cfs_rq = 0;
+  se->parent = 0;
+  se->my_q = 0;
+
+  init_avg(&se->avg, us);
+
+  se->policy = SCHED_NORMAL;
+  se->sched_class = &fair_sched_class;
+  se->rt.next = se->rt.prev = 0;
+  se->rt.prio = 0;
+  se->rt.time_slice = RR_TIMESLICE_US;
+  se->rt.on_rq = 0;
+
+  se->dl.node.__rb_parent_color = 0;
+  se->dl.node.rb_left = se->dl.node.rb_right = 0;
+  se->dl.dl_runtime = se->dl.dl_deadline = se->dl.dl_period = 0;
+  se->dl.dl_bw = 0;
+  se->dl.runtime = 0;
+  se->dl.deadline = 0;
+  se->dl.on_rq = 0;
+  se->dl.dl_throttled = 0;
+}
+
+
+/*
+ * A new task joins cfs_rq: it starts at min_vruntime with zero lag,
+ * so it neither owes nor is owed time, and with a fork's averages
+ * Its weight and slice must be set first
+ */
+void
+place_new_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
+{
+  se->cfs_rq = cfs_rq;
+
+  // Execute forked-child first
+  se->exec_start = 0;
+  se->sum_exec_runtime = 0;
+  se->vruntime = cfs_rq->min_vruntime;
+  se->tot_exec_runtime = 0;
+
+  // A new task starts with zero lag
+  se->deadline = se->vruntime;
+  se->vlag = 0;
+  se->lag_saved = 1;
+
+  init_fork_avg(cfs_rq, se, us);
+}
+
+
+void
+copy_entity(struct sched_entity *pse, struct sched_entity *cse)
+{
+  struct cfs_rq *cfs_rq = pse->cfs_rq;
+  cse->on_rq = 0;
+
+  cse->load.nice = pse->load.nice;
+  cse->load.weight = pse->load.weight;
+  cse->load.inv_weight = pse->load.inv_weight;
+  cse->cfs_rq = cfs_rq; // affinity?
+  cse->parent = pse->parent;
+  cse->my_q = 0;
+  cse->cpus_allowed = pse->cpus_allowed;
+  cse->cpu = pse->cpu;
+
+  // Scheduling policy is inherited, but not a deadline
+  // reservation: the child of a SCHED_DEADLINE task is fair
+  cse->policy = pse->policy;
+  cse->sched_class = pse->sched_class;
+  if(pse->policy == SCHED_DEADLINE) {
+    cse->policy = SCHED_NORMAL;
+    cse->sched_class = &fair_sched_class;
+  }
+  cse->dl.on_rq = 0;
+  cse->dl.dl_throttled = 0;
+  cse->dl.dl_bw = 0;
+  cse->rt.next = cse->rt.prev = 0;
+  cse->rt.prio = pse->rt.prio;
+  cse->rt.time_slice = RR_TIMESLICE_US;
+  cse->rt.on_rq = 0;
+
+  cse->slice = pse->slice;
+  place_new_entity(cfs_rq, cse);
+}
+
+
+void
+reset_entity(struct sched_entity *se, u64 us)
+{
+  // set exec_start as current time
+  // clear sum_exec_runtime of entity
+  se->exec_start = us;
+  se->sum_exec_runtime = 0;
+}
+
+
+int
+get_nice_entity(struct sched_entity *se)
+{
+  return se->load.nice;
+}
+
+
+/* Weight from nice, or the idle weight for SCHED_IDLE */
+static void
+set_load_entity(struct sched_entity *se)
+{
+  if(se->policy == SCHED_IDLE) {
+    se->load.weight = WEIGHT_IDLEPRIO;
+    se->load.inv_weight = WMULT_IDLEPRIO;
+  } else {
+    se->load.weight = prio_to_weight[se->load.nice+20];
+    se->load.inv_weight = prio_to_wmult[se->load.nice+20];
+  }
+}
+
+
+void
+set_nice_entity(struct sched_entity *se, int nice)
 {
   se->load.nice = nice;
-  se->load.weight = prio_to_weight[nice+20];
-  se->load.inv_weight = prio_to_wmult[nice+20];
-}
\ No newline at end of file
+  set_load_entity(se);
+}
+
+
+/* ----- Task group modification ----- */
+void
+set_shares_group(struct task_group *tg, uint shares)
+{
+  struct sched_entity *se = &tg->se;
+  struct cfs_rq *cfs_rq = se->cfs_rq;
+
+  shares = max(shares, MIN_SHARES);
+  shares = min(shares, MAX_SHARES);
+
+  if(se->on_rq) {
+    cfs_rq->load.weight -= se->load.weight;
+    if(SCHED_EEVDF)
+      avg_vruntime_sub(cfs_rq, se);
+  }
+
+  tg->shares = shares;
+  se->load.weight = shares;
+  update_qinv_weight(&se->load);
+
+  if(se->on_rq) {
+    cfs_rq->load.weight += se->load.weight;
+    if(SCHED_EEVDF)
+      avg_vruntime_add(cfs_rq, se);
+    update_qinv_weight(&cfs_rq->load);
+  }
+}
+
+
+void
+init_task_group(struct task_group *tg, struct task_group *parent,
+                struct cfs_rq *parent_q)
+{
+  init_cfs_rq(&tg->cfs_rq);
+  tg->cfs_rq.tg = tg;
+  tg->parent = parent;
+
+  init_entity(&tg->se);
+  tg->se.my_q = &tg->cfs_rq;
+  tg->se.cpus_allowed = 0;  // no member queued yet
+  tg->se.cfs_rq = parent_q;
+  tg->se.parent = parent ? &parent->se : 0;
+  tg->se.vruntime = parent_q->min_vruntime;
+
+  set_shares_group(tg, NICE_0_WEIGHT);
+
+  tg->quota = 0;
+  tg->period = DEF_CFS_PERIOD_US;
+  tg->runtime_remaining = 0;
+  tg->period_end = 0;
+  tg->throttled = 0;
+  tg->throttled_at = 0;
+  tg->nr_periods = 0;
+  tg->nr_throttled = 0;
+  tg->throttled_time = 0;
+}
+
+
+/*
+ * Set tg's quota per period, in us (quota 0: unlimited)
+ * A new period starts right away
+ */
+void
+set_bandwidth_group(struct task_group *tg, u64 quota, u64 period, u64 now)
+{
+  tg->quota = quota;
+  tg->period = period;
+  tg->runtime_remaining = 0;
+
+  if(quota)
+    refill_group(tg, now);
+  else if(tg->throttled)
+    unthrottle_group(tg, now);
+}
+
+
+/*
+ * Move a process entity to queue cfs_rq owned by group tg (0: root)
+ * A queued entity is requeued; a running one is detached from the
+ * current-entity chain of its old groups
+ */
+void
+move_entity_group(struct sched_entity *se, struct cfs_rq *cfs_rq,
+                  struct task_group *tg)
+{
+  uint queued = se->on_rq;
+
+  if(queued)
+    dequeue_entity_fair(se->cfs_rq, se);
+  else
+    put_curr_entity_fair(se);
+
+  se->cfs_rq = cfs_rq;
+  se->parent = tg ? &tg->se : 0;
+  se->vruntime = cfs_rq->min_vruntime;
+  se->deadline = se->vruntime + calc_delta_vslice(se->slice, se);
+
+  if(queued)
+    enqueue_entity_fair(cfs_rq, se);
+}
+
+
+
+/* ----- Fair scheduling class ----- */
+static void
+enqueue_task_fair(struct rq *rq, struct sched_entity *se)
+{
+  if(SCHED_EEVDF && se->lag_saved)
+    place_entity(se->cfs_rq, se);
+  enqueue_entity_fair(se->cfs_rq, se);
+}
+
+
+static void
+dequeue_task_fair(struct rq *rq, struct sched_entity *se)
+{
+  if(SCHED_EEVDF)
+    save_lag(se->cfs_rq, se);
+  dequeue_entity_fair(se->cfs_rq, se);
+}
+
+
+static struct sched_entity*
+pick_task_fair(struct rq *rq, int cpu)
+{
+  return pick_next_entity_fair(&rq->cfs, cpu);
+}
+
+
+static void
+set_curr_task_fair(struct rq *rq, struct sched_entity *se)
+{
+  set_curr_entity_fair(se);
+}
+
+
+static void
+put_curr_task_fair(struct rq *rq, struct sched_entity *se)
+{
+  put_curr_entity_fair(se);
+}
+
+
+static void
+tick_task_fair(struct rq *rq, struct sched_entity *se, u64 now)
+{
+  update_entity_stat(se, now);
+}
+
+
+/*
+ * sched_yield(): go behind the leftmost entity of the queue
+ * Under EEVDF, ask for the next slice at once instead
+ */
+static void
+yield_task_fair(struct rq *rq, struct sched_entity *se)
+{
+  struct cfs_rq *cfs_rq = se->cfs_rq;
+  struct sched_entity *left;
+
+  if(SCHED_EEVDF) {
+    se->deadline += calc_delta_vslice(se->slice, se);
+    return;
+  }
+
+  if(!cfs_rq->leftmost)
+    return;
+  left = se_entry(cfs_rq->leftmost, struct sched_entity, run_node);
+  if((long long)(se->vruntime - left->vruntime) <= 0)
+    se->vruntime = left->vruntime + 1;
+}
+
+
+/*
+ * Directed yield: make target, queued, the next buddy at every level
+ * Sharing a queue, under CFS, se also hands target the rest of its
+ * slice: se is charged it, and target gains it in virtual time but
+ * never goes below min_vruntime. Under EEVDF se yields its slice.
+ */
+static int
+yield_to_task_fair(struct rq *rq, struct sched_entity *se,
+                   struct sched_entity *target)
+{
+  struct cfs_rq *cfs_rq = target->cfs_rq;
+  struct sched_entity *t;
+  u64 ideal, left, gain;
+
+  if(!target->on_rq || throttled_entity(target) ||
+     !cpu_allowed(target, se->cpu))
+    return -1;
+
+  if(SCHED_EEVDF)
+    yield_task_fair(rq, se);
+  else if(cfs_rq == se->cfs_rq) {
+    ideal = calc_slice(cfs_rq, se);
+    if(ideal > se->sum_exec_runtime) {
+      left = ideal - se->sum_exec_runtime;
+      se->vruntime += calc_delta_vslice(left, se);
+
+      gain = calc_delta_vslice(left, target);
+      target->vruntime = max(target->vruntime - gain, cfs_rq->min_vruntime);
+      requeue_entity_fair(cfs_rq, target);
+    }
+  }
+
+  for(t = target; t && t->on_rq; t = t->parent)
+    t->cfs_rq->next = t;
+  return 0;
+}
+
+
+static int
+check_preempt_fair(struct rq *rq, struct sched_entity *se)
+{
+  /* A throttled proc goes even if nothing else is runnable */
+  if(throttled_entity(se))
+    return 1;
+  if(!rq->cfs.nr_running)
+    return 0;
+  return check_yield(se);
+}
+
+
+const struct sched_class fair_sched_class = {
+  .next           = 0,
+  .enqueue        = enqueue_task_fair,
+  .dequeue        = dequeue_task_fair,
+  .pick           = pick_task_fair,
+  .set_curr       = set_curr_task_fair,
+  .put_curr       = put_curr_task_fair,
+  .tick           = tick_task_fair,
+  .check_preempt  = check_preempt_fair,
+  .yield          = yield_task_fair,
+  .yield_to       = yield_to_task_fair,
+};
+
+
+/* ----- Real-time scheduling class ----- */
+
+/*
+ * Fixed priorities, highest first; FIFO within a priority
+ * SCHED_FIFO runs until it blocks or a higher priority arrives,
+ * SCHED_RR also rotates among its priority every RR_TIMESLICE_US
+ * RT and deadline tasks together may only use rt_runtime per
+ * RT_PERIOD_US, so runaway RT tasks cannot starve the fair class:
+ * deadline tasks run first and are charged too, so RT gets what
+ * they leave over
+ */
+void
+init_rt_rq(struct rt_rq *rt_rq, u64 rt_runtime)
+{
+  int i;
+
+  for(i = 0; i < MAX_RT_PRIO; i++)
+    rt_rq->queue[i] = 0;
+  for(i = 0; i < RT_BITMAP_WORDS; i++)
+    rt_rq->bitmap[i] = 0;
+  rt_rq->nr_running = 0;
+
+  rt_rq->rt_runtime = rt_runtime;
+  rt_rq->rt_time = 0;
+  rt_rq->period_end = RT_PERIOD_US;
+  rt_rq->rt_throttled = 0;
+}
+
+
+static void
+enqueue_task_rt(struct rq *rq, struct sched_entity *se)
+{
+  struct rt_rq *rt_rq = &rq->rt;
+  struct sched_rt_entity *rt = &se->rt;
+  struct sched_rt_entity **head = &rt_rq->queue[rt->prio];
+
+  if(rt->on_rq)
+    return;
+
+  if(!*head) {
+    rt->next = rt->prev = rt;
+    *head = rt;
+    rt_rq->bitmap[rt->prio/32] |= 1U << (rt->prio%32);
+  } else {
+    /* Append at the tail */
+    rt->next = *head;
+    rt->prev = (*head)->prev;
+    rt->prev->next = rt;
+    (*head)->prev = rt;
+  }
+
+  rt->on_rq = 1;
+  rt_rq->nr_running++;
+}
+
+
+static void
+dequeue_task_rt(struct rq *rq, struct sched_entity *se)
+{
+  struct rt_rq *rt_rq = &rq->rt;
+  struct sched_rt_entity *rt = &se->rt;
+  struct sched_rt_entity **head = &rt_rq->queue[rt->prio];
+
+  if(!rt->on_rq)
+    return;
+
+  if(rt->next == rt) {
+    *head = 0;
+    rt_rq->bitmap[rt->prio/32] &= ~(1U << (rt->prio%32));
+  } else {
+    rt->prev->next = rt->next;
+    rt->next->prev = rt->prev;
+    if(*head == rt)
+      *head = rt->next;
+  }
+  rt->next = rt->prev = 0;
+
+  rt->on_rq = 0;
+  rt_rq->nr_running--;
+}
+
+
+/*
+ * First entity of the highest priority allowed on cpu
+ * Priorities are visited through the bitmap, highest first; lists
+ * are walked only past entities pinned to other CPUs
+ */
+static struct sched_entity*
+pick_task_rt(struct rq *rq, int cpu)
+{
+  struct rt_rq *rt_rq = &rq->rt;
+  struct sched_rt_entity *head, *rt;
+  struct sched_entity *se;
+  uint bits;
+  int i, b;
+
+  if(!rt_rq->nr_running || rt_rq->rt_throttled)
+    return 0;
+
+  for(i = RT_BITMAP_WORDS - 1; i >= 0; i--) {
+    for(bits = rt_rq->bitmap[i]; bits; bits &= ~(1U << b)) {
+      b = 31 - __builtin_clz(bits);
+      rt = head = rt_rq->queue[i*32 + b];
+      do {
+        se = se_entry(rt, struct sched_entity, rt);
+        if(cpu_allowed(se, cpu))
+          return se;
+        rt = rt->next;
+      } while(rt != head);
+    }
+  }
+  return 0;
+}
+
+
+static void
+set_curr_task_rt(struct rq *rq, struct sched_entity *se)
+{
+  dequeue_task_rt(rq, se);
+}
+
+
+static void
+put_curr_task_rt(struct rq *rq, struct sched_entity *se)
+{
+}
+
+
+static void
+tick_task_rt(struct rq *rq, struct sched_entity *se, u64 now)
+{
+  struct rt_rq *rt_rq = &rq->rt;
+  u64 delta_exec = now - se->exec_start;
+
+  se->exec_start = now;
+  se->sum_exec_runtime += delta_exec;
+  se->tot_exec_runtime += delta_exec;
+
+  rt_rq->rt_time += delta_exec;
+  if(rt_rq->rt_time >= rt_rq->rt_runtime)
+    rt_rq->rt_throttled = 1;
+
+  if(se->policy == SCHED_RR)
+    se->rt.time_slice -= min(se->rt.time_slice, delta_exec);
+}
+
+
+static int
+check_preempt_rt(struct rq *rq, struct sched_entity *se)
+{
+  struct rt_rq *rt_rq = &rq->rt;
+  struct sched_entity *next;
+
+  if(rt_rq->rt_throttled)
+    return 1;
+
+  next = pick_task_rt(rq, se->cpu);
+  if(next && next->rt.prio > se->rt.prio)
+    return 1;
+
+  /* Round robin: rotate only if a peer of the same priority waits */
+  if(se->policy == SCHED_RR && !se->rt.time_slice) {
+    se->rt.time_slice = RR_TIMESLICE_US;
+    return rt_rq->queue[se->rt.prio] != 0;
+  }
+  return 0;
+}
+
+
+/*
+ * Start a new RT bandwidth period once the current one is over
+ * Called from the timer interrupt
+ */
+void
+refill_rt_rq(struct rt_rq *rt_rq, u64 now)
+{
+  if(now < rt_rq->period_end)
+    return;
+
+  rt_rq->rt_time = 0;
+  rt_rq->rt_throttled = 0;
+  rt_rq->period_end = now + RT_PERIOD_US;
+}
+
+
+const struct sched_class rt_sched_class = {
+  .next           = &fair_sched_class,
+  .enqueue        = enqueue_task_rt,
+  .dequeue        = dequeue_task_rt,
+  .pick           = pick_task_rt,
+  .set_curr       = set_curr_task_rt,
+  .put_curr       = put_curr_task_rt,
+  .tick           = tick_task_rt,
+  .check_preempt  = check_preempt_rt,
+};
+
+
+/* ----- Deadline scheduling class ----- */
+
+/*
+ * Earliest deadline first among SCHED_DEADLINE tasks, above RT
+ * Each task is a constant-bandwidth server: it gets dl_runtime us
+ * by each deadline, at most dl_runtime every dl_period. Running
+ * out of runtime throttles it until its deadline, when the next
+ * instance is replenished; so an overrunning task cannot take more
+ * than its reserved bandwidth from others
+ */
+static u64
+to_ratio(u64 period, u64 runtime)
+{
+  return div_u64(runtime << BW_SHIFT, period);
+}
+
+
+void
+init_dl_rq(struct dl_rq *dl_rq, u64 max_bw)
+{
+  dl_rq->root.rb_node = 0;
+  dl_rq->leftmost = 0;
+  dl_rq->nr_running = 0;
+
+  dl_rq->throttled.rb_node = 0;
+  dl_rq->next_replenish = 0;
+
+  dl_rq->total_bw = 0;
+  dl_rq->max_bw = max_bw;
+}
+
+
+/* Start a new instance, paying back any overrun first */
+static void
+replenish_dl_entity(struct sched_dl_entity *dl, u64 now)
+{
+  while(dl->runtime <= 0) {
+    dl->deadline += dl->dl_period;
+    dl->runtime += dl->dl_runtime;
+  }
+
+  /* Too far behind to catch up: start afresh */
+  if((long long)(dl->deadline - now) < 0) {
+    dl->deadline = now + dl->dl_deadline;
+    dl->runtime = dl->dl_runtime;
+  }
+}
+
+
+/*
+ * CBS wakeup rule: keep the current instance only if its deadline
+ * is ahead and the runtime left fits in the reserved bandwidth
+ * until then, i.e. runtime / (deadline - now) <= dl_runtime / dl_deadline
+ */
+static void
+update_dl_entity(struct sched_dl_entity *dl, u64 now)
+{
+  if((long long)(dl->deadline - now) <= 0 ||
+     (u64)dl->runtime * dl->dl_deadline > (dl->deadline - now) * dl->dl_runtime) {
+    dl->deadline = now + dl->dl_deadline;
+    dl->runtime = dl->dl_runtime;
+  }
+}
+
+
+/*
+ * The EDF tree caches, per subtree, the CPUs its entities may run
+ * on, to find the earliest deadline allowed on a CPU in O(log n)
+ */
+# define dl_entry(n)	rb_entry(n, struct sched_dl_entity, node)
+
+static uint
+dl_subtree_cpus(struct sched_dl_entity *dl)
+{
+  uint cpus = se_entry(dl, struct sched_entity, dl)->cpus_allowed;
+
+  if(dl->node.rb_left)
+    cpus |= dl_entry(dl->node.rb_left)->subtree_cpus;
+  if(dl->node.rb_right)
+    cpus |= dl_entry(dl->node.rb_right)->subtree_cpus;
+  return cpus;
+}
+
+
+static void
+dl_propagate(struct rb_node *node, struct rb_node *stop)
+{
+  while(node != stop) {
+    struct sched_dl_entity *dl = dl_entry(node);
+    uint cpus = dl_subtree_cpus(dl);
+
+    if(dl->subtree_cpus == cpus)
+      break;
+    dl->subtree_cpus = cpus;
+    node = rb_parent(node);
+  }
+}
+
+
+static void
+dl_copy(struct rb_node *old, struct rb_node *new)
+{
+  dl_entry(new)->subtree_cpus = dl_entry(old)->subtree_cpus;
+}
+
+
+static void
+dl_rotate(struct rb_node *old, struct rb_node *new)
+{
+  dl_copy(old, new);
+  dl_entry(old)->subtree_cpus = dl_subtree_cpus(dl_entry(old));
+}
+
+
+static const struct rb_augment_callbacks dl_cb = {
+  .propagate  = dl_propagate,
+  .copy       = dl_copy,
+  .rotate     = dl_rotate,
+};
+
+
+static void
+dl_tree_insert(struct dl_rq *dl_rq, struct sched_dl_entity *dl)
+{
+  dl->node.key = dl->deadline;
+  dl->subtree_cpus = se_entry(dl, struct sched_entity, dl)->cpus_allowed;
+  rb_insert_augmented(&dl->node, &dl_rq->root, &dl_cb);
+  dl_rq->leftmost = rb_leftmost(&dl_rq->root);
+  dl_rq->nr_running++;
+}
+
+
+static void
+dl_tree_delete(struct dl_rq *dl_rq, struct sched_dl_entity *dl)
+{
+  rb_delete_augmented(&dl->node, &dl_rq->root, &dl_cb);
+  dl_rq->leftmost = rb_leftmost(&dl_rq->root);
+  dl_rq->nr_running--;
+}
+
+
+static void
+enqueue_task_dl(struct rq *rq, struct sched_entity *se)
+{
+  struct dl_rq *dl_rq = &rq->dl;
+  struct sched_dl_entity *dl = &se->dl;
+
+  if(dl->on_rq)
+    return;
+
+  dl->node.key = dl->deadline;
+  dl->on_rq = 1;
+
+  if(dl->dl_throttled) {
+    /* Wait for the replenishment at the deadline */
+    if((long long)(dl->deadline - rq->clock) > 0) {
+      rb_insert(&dl->node, &dl_rq->throttled);
+      dl_rq->next_replenish = rb_leftmost(&dl_rq->throttled);
+      return;
+    }
+    dl->dl_throttled = 0;
+    replenish_dl_entity(dl, rq->clock);
+  } else
+    update_dl_entity(dl, rq->clock);
+
+  dl_tree_insert(dl_rq, dl);
+}
+
+
+static void
+dequeue_task_dl(struct rq *rq, struct sched_entity *se)
+{
+  struct dl_rq *dl_rq = &rq->dl;
+  struct sched_dl_entity *dl = &se->dl;
+
+  if(!dl->on_rq)
+    return;
+
+  if(dl->dl_throttled) {
+    rb_delete(&dl->node, &dl_rq->throttled);
+    dl_rq->next_replenish = rb_leftmost(&dl_rq->throttled);
+  } else
+    dl_tree_delete(dl_rq, dl);
+  dl->on_rq = 0;
+}
+
+
+/* Earliest deadline allowed on cpu */
+static struct sched_entity*
+pick_task_dl(struct rq *rq, int cpu)
+{
+  struct rb_node *node = rq->dl.root.rb_node;
+  struct rb_node *left;
+  struct sched_entity *se;
+
+  if(!node || !((dl_entry(node)->subtree_cpus >> cpu) & 1))
+    return 0;
+
+  for(;;) {
+    left = node->rb_left;
+    se = se_entry(node, struct sched_entity, dl.node);
+    if(left && ((dl_entry(left)->subtree_cpus >> cpu) & 1))
+      node = left;
+    else if(cpu_allowed(se, cpu))
+      return se;
+    else
+      node = node->rb_right;
+  }
+}
+
+
+static void
+set_curr_task_dl(struct rq *rq, struct sched_entity *se)
+{
+  dequeue_task_dl(rq, se);
+}
+
+
+static void
+put_curr_task_dl(struct rq *rq, struct sched_entity *se)
+{
+}
+
+
+static void
+tick_task_dl(struct rq *rq, struct sched_entity *se, u64 now)
+{
+  struct sched_dl_entity *dl = &se->dl;
+  u64 delta_exec = now - se->exec_start;
+
+  se->exec_start = now;
+  se->sum_exec_runtime += delta_exec;
+  se->tot_exec_runtime += delta_exec;
+
+  /* Shares the RT budget, see init_rt_rq() */
+  rq->rt.rt_time += delta_exec;
+  if(rq->rt.rt_time >= rq->rt.rt_runtime)
+    rq->rt.rt_throttled = 1;
+
+  dl->runtime -= delta_exec;
+  if(dl->runtime > 0)
+    return;
+
+  /* Out of runtime: throttle until the deadline, unless it passed */
+  if((long long)(dl->deadline - now) <= 0)
+    replenish_dl_entity(dl, now);
+  else
+    dl->dl_throttled = 1;
+}
+
+
+static int
+check_preempt_dl(struct rq *rq, struct sched_entity *se)
+{
+  struct sched_entity *next;
+
+  if(se->dl.dl_throttled)
+    return 1;
+
+  next = pick_task_dl(rq, se->cpu);
+  return next && (long long)(next->dl.deadline - se->dl.deadline) < 0;
+}
+
+
+/*
+ * Replenish the throttled reservations whose deadline has come
+ * Called from the timer interrupt
+ */
+void
+replenish_dl_rq(struct dl_rq *dl_rq, u64 now)
+{
+  struct sched_dl_entity *dl;
+
+  while(dl_rq->next_replenish && dl_rq->next_replenish->key <= now) {
+    dl = se_entry(dl_rq->next_replenish, struct sched_dl_entity, node);
+
+    rb_delete(&dl->node, &dl_rq->throttled);
+    dl_rq->next_replenish = rb_leftmost(&dl_rq->throttled);
+
+    dl->dl_throttled = 0;
+    replenish_dl_entity(dl, now);
+    dl_tree_insert(dl_rq, dl);
+  }
+}
+
+
+const struct sched_class dl_sched_class = {
+  .next           = &rt_sched_class,
+  .enqueue        = enqueue_task_dl,
+  .dequeue        = dequeue_task_dl,
+  .pick           = pick_task_dl,
+  .set_curr       = set_curr_task_dl,
+  .put_curr       = put_curr_task_dl,
+  .tick           = tick_task_dl,
+  .check_preempt  = check_preempt_dl,
+};
+
+
+/* ----- Class dispatch ----- */
+void
+init_rq(struct rq *rq, int ncpu)
+{
+  init_cfs_rq(&rq->cfs);
+  init_rt_rq(&rq->rt, (u64)RT_RUNTIME_US * ncpu);
+  /* Deadline tasks together may use what RT tasks may */
+  init_dl_rq(&rq->dl, to_ratio(RT_PERIOD_US, RT_RUNTIME_US) * ncpu);
+  rq->clock = 0;
+}
+
+
+void
+enqueue_task(struct rq *rq, struct sched_entity *se)
+{
+  se->sched_class->enqueue(rq, se);
+}
+
+
+void
+dequeue_task(struct rq *rq, struct sched_entity *se)
+{
+  se->sched_class->dequeue(rq, se);
+}
+
+
+/* Ask every class, highest first, for an entity to run on cpu */
+struct sched_entity*
+pick_next_task(struct rq *rq, int cpu)
+{
+  const struct sched_class *class;
+  struct sched_entity *se;
+
+  for(class = sched_class_highest; class; class = class->next)
+    if((se = class->pick(rq, cpu)) != 0)
+      return se;
+  return 0;
+}
+
+
+void
+set_curr_task(struct rq *rq, struct sched_entity *se, int cpu)
+{
+  se->cpu = cpu;
+  se->sched_class->set_curr(rq, se);
+}
+
+
+void
+put_curr_task(struct rq *rq, struct sched_entity *se)
+{
+  se->sched_class->put_curr(rq, se);
+}
+
+
+/*
+ * Should the running entity se give up the CPU?
+ * It must if it may no longer run here, or if anything runnable
+ * here is in a higher class; within its own class, the class decides
+ */
+int
+check_preempt_curr(struct rq *rq, struct sched_entity *se)
+{
+  const struct sched_class *class;
+
+  if(!cpu_allowed(se, se->cpu))
+    return 1;
+
+  for(class = sched_class_highest; class != se->sched_class; class = class->next)
+    if(class->pick(rq, se->cpu))
+      return 1;
+  return se->sched_class->check_preempt(rq, se);
+}
+
+
+/*
+ * Change se's policy and its parameters, checked by the caller
+ * A deadline reservation is admitted only if the total bandwidth
+ * stays within dl_rq->max_bw; returns -1 if it does not fit
+ * A queued entity moves to its new class's queue; a running one
+ * is let go by its old class and queued by the new one on yield
+ */
+int
+set_policy_entity(struct rq *rq, struct sched_entity *se, struct sched_attr *attr)
+{
+  struct sched_dl_entity *dl = &se->dl;
+  uint queued = se->on_rq || se->rt.on_rq || dl->on_rq;
+  u64 old_bw = se->policy == SCHED_DEADLINE ? dl->dl_bw : 0;
+  u64 new_bw = 0;
+
+  if(attr->policy == SCHED_DEADLINE) {
+    new_bw = to_ratio(attr->period, attr->runtime);
+    if(rq->dl.total_bw - old_bw + new_bw > rq->dl.max_bw)
+      return -1;
+  }
+
+  if(queued)
+    dequeue_task(rq, se);
+  else
+    put_curr_task(rq, se);
+
+  rq->dl.total_bw += new_bw - old_bw;
+
+  se->policy = attr->policy;
+  se->rt.prio = attr->prio;
+  se->rt.time_slice = RR_TIMESLICE_US;
+
+  switch(attr->policy) {
+  case SCHED_NORMAL:
+  case SCHED_BATCH:
+  case SCHED_IDLE:
+    se->sched_class = &fair_sched_class;
+    set_load_entity(se);
+    se->vruntime = max(se->vruntime, se->cfs_rq->min_vruntime);
+    se->vlag = 0;
+    se->lag_saved = 1;
+    break;
+  case SCHED_DEADLINE:
+    se->sched_class = &dl_sched_class;
+    dl->dl_runtime = attr->runtime;
+    dl->dl_deadline = attr->deadline;
+    dl->dl_period = attr->period;
+    dl->dl_bw = new_bw;
+    dl->runtime = dl->dl_runtime;
+    dl->deadline = rq->clock + dl->dl_deadline;
+    dl->dl_throttled = 0;
+    break;
+  default:
+    se->sched_class = &rt_sched_class;
+  }
+
+  if(queued)
+    enqueue_task(rq, se);
+  return 0;
+}
+
+
+/*
+ * Restrict se to the CPUs in cpus; a queued entity is requeued
+ * so the masks cached in the trees stay right. A running entity
+ * on a CPU it may no longer use is preempted at the next tick
+ */
+void
+set_affinity_entity(struct rq *rq, struct sched_entity *se, uint cpus)
+{
+  uint queued = se->on_rq || se->rt.on_rq || se->dl.on_rq;
+
+  if(queued)
+    dequeue_task(rq, se);
+  se->cpus_allowed = cpus;
+  if(queued)
+    enqueue_task(rq, se);
+}
+
+
+/*
+ * The running entity se is about to give up the CPU by choice
+ * An RT entity goes behind its priority's list when requeued
+ */
+void
+yield_task(struct rq *rq, struct sched_entity *se)
+{
+  if(se->sched_class->yield)
+    se->sched_class->yield(rq, se);
+}
+
+
+/* ... in favour of target, of the same class; -1 if it cannot */
+int
+yield_to_task(struct rq *rq, struct sched_entity *se, struct sched_entity *target)
+{
+  if(target->sched_class != se->sched_class || !se->sched_class->yield_to)
+    return -1;
+  return se->sched_class->yield_to(rq, se, target);
+}
+
+
+/* se exits: take it off its queue and give back its reservation */
+void
+exit_task(struct rq *rq, struct sched_entity *se)
+{
+  dequeue_task(rq, se);
+  if(se->policy == SCHED_DEADLINE)
+    rq->dl.total_bw -= se->dl.dl_bw;
+}
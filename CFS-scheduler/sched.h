@@ -4,27 +4,113 @@
 // sched.h
 # include "rbtree.h"
 # include "types.h"
+# include "schedpolicy.h"
 
 /* In standard xv6, 1 tick = 10 ms
  * But I tuned 1 tick = 1 ms = 1000 us
  * And treat all data about time slice as 'us' unit
  * so, every tick, delta_exec goes up * 1000
  *
- * Set schedule latency	   as 18,000 us (18 ticks)
- * Set minimum granularity as  3,000 us ( 3 ticks)
+ * Default schedule latency	   18,000 us (18 ticks)
+ * Default minimum granularity  3,000 us ( 3 ticks)
+ * for one CPU; see sysctl_sched for the values in use
  */
 
 # define SCHED_LATENCY_US		18000
 # define SCHED_MIN_GRANULARITY	 3000
-# define SCHED_NR_LATENCY		(SCHED_LATENCY_US/SCHED_MIN_GRANULARITY)
+# define SCHED_WAKEUP_GRANULARITY 1000
+# define SCHED_MIGRATION_COST	  500
+# define MAX_SCHED_LATENCY_US 1000000
 # define NICE_0_WEIGHT			1024
+/* SCHED_IDLE weight, far below nice 19 (15), and its 2^32/weight */
+# define WEIGHT_IDLEPRIO		3
+# define WMULT_IDLEPRIO			1431655765
+/* SCHED_BATCH runs at least this long once picked */
+# define SCHED_BATCH_GRANULARITY 12000
+# define MIN_SHARES             2
+# define MAX_SHARES        (1<<18)
+# define DEF_CFS_PERIOD_US  100000
+# define MIN_CFS_PERIOD_US    1000
+# define MAX_CFS_PERIOD_US 1000000
+
+/*
+ * EEVDF: pick the eligible entity (vruntime <= load-weighted average)
+ * with the earliest virtual deadline, instead of the smallest vruntime
+ * Chosen at build time ('make EEVDF=1') so both run the same workloads
+ * Each entity asks for a slice; a shorter one means earlier deadlines
+ */
+# ifndef SCHED_EEVDF
+# define SCHED_EEVDF            0
+# endif
+# define SCHED_BASE_SLICE_US  3000
+# define MIN_SLICE_US         1000
+# define MAX_SLICE_US       100000
+
+/* Real-time class, see schedpolicy.h for policies and priorities */
+# define RT_BITMAP_WORDS    ((MAX_RT_PRIO+31)/32)
+# define RR_TIMESLICE_US   100000
+/* RT and DL tasks together may use at most RT_RUNTIME_US per CPU every RT_PERIOD_US */
+# define RT_PERIOD_US     1000000
+# define RT_RUNTIME_US     950000
+
+/* Deadline class: bandwidths are runtime/period in BW_SHIFT fixed point */
+# define BW_SHIFT               20
+# define MIN_DL_RUNTIME_US    1000
+# define MAX_DL_PERIOD_US 10000000
+/*
+ * Load tracking: runnable and running time, summed over 1024 us
+ * periods with each period weighing y^n, y^32 = 1/2
+ * LOAD_AVG_MAX is the sum of 1024 * y^n over all n
+ */
+# define PELT_PERIOD_US       1024
+# define LOAD_AVG_PERIOD        32
+# define LOAD_AVG_MAX        47742
+# define SCHED_CAPACITY_SHIFT   10
+# define SCHED_CAPACITY_SCALE (1<<SCHED_CAPACITY_SHIFT)
 # define WMULT_CONST        0xFFFFFFFF
-# define ALLOW_LOG          0
+# define CPU_MASK_ALL       0xFFFFFFFF
+# define ALLOW_LOG          (sysctl_sched.log)
 
 # define se_entry(ptr, type, member) \
   				container_of(ptr, type, member)
 
 
+/*
+ * u64 / uint
+ * The kernel is not linked with libgcc, so there is no __udivdi3:
+ * divide the high word first, then let divl do the rest
+ */
+static inline u64
+div_u64(u64 n, uint d)
+{
+  uint hi = n >> 32, lo = n;
+  uint q_hi = hi / d, q_lo, r;
+
+  hi %= d;
+  asm("divl %4" : "=a" (q_lo), "=d" (r) : "a" (lo), "d" (hi), "rm" (d));
+  return ((u64)q_hi << 32) | q_lo;
+}
+
+
+/* long long / uint, rounding towards zero */
+static inline long long
+div_s64(long long n, uint d)
+{
+  if(n < 0)
+    return -(long long)div_u64(-n, d);
+  return div_u64(n, d);
+}
+
+
+
+struct sched_entity;
+struct task_group;
+
+/*
+ * Tunables in use, changed as a whole under the lock that
+ * guards the run queues, so no slice is computed from a mix
+ */
+extern struct sched_tunables sysctl_sched;
 
 extern const int prio_to_weight[40];
 extern const uint prio_to_wmult[40];
@@ -37,15 +123,146 @@ struct load_weight
 };
 
 
+/*
+ * Decaying averages of an entity or a queue
+ * load:     runnable, times weight
+ * runnable: runnable (entities queued, for a queue), of SCHED_CAPACITY_SCALE
+ * util:     running, of SCHED_CAPACITY_SCALE
+ * Only reported to user space so far: all CPUs share one run queue
+ * and nothing picks a CPU for a task, so there is no placement
+ * decision yet to feed them into
+ */
+struct sched_avg
+{
+  u64                 last_update_time; // us
+  u64                 load_sum;
+  u64                 runnable_sum;
+  uint                util_sum;
+  uint                period_contrib;   // us of the current period seen
+  uint                load_avg;
+  uint                runnable_avg;
+  uint                util_avg;
+};
+
+
 struct cfs_rq
 {
   struct load_weight	load;
   int                 nr_running;
+  int                 idle_nr_running;  // SCHED_IDLE entities queued
   u64                 min_vruntime;
 
   struct rb_root		  proc_timeline;
   struct rb_node		  *leftmost;
   struct sched_entity	*curr;
+  struct sched_entity	*next;  // buddy to run next if fair enough, or 0
+  struct task_group   *tg;    // owner, 0 for the root queue
+
+  /* EEVDF: sum of (vruntime - min_vruntime) * weight, and of weights,
+   * over the queued entities */
+  long long           avg_vruntime;
+  uint                avg_load;
+
+  struct sched_avg    avg;
+};
+
+
+/* One list per RT priority, and a bitmap of non-empty lists */
+struct rt_rq
+{
+  struct sched_rt_entity *queue[MAX_RT_PRIO];
+  uint                bitmap[RT_BITMAP_WORDS];
+  int                 nr_running;
+
+  u64                 rt_runtime;   // allowed per RT_PERIOD_US, all CPUs
+  u64                 rt_time;      // used by RT and DL in this period
+  u64                 period_end;
+  int                 rt_throttled;
+};
+
+
+/* Per-process state of the real-time class */
+struct sched_rt_entity
+{
+  struct sched_rt_entity *next;     // circular list of one priority
+  struct sched_rt_entity *prev;
+  int                 prio;
+  u64                 time_slice;   // SCHED_RR: left in this slice
+  uint                on_rq;
+};
+
+
+/*
+ * EDF queue, ordered by absolute deadline
+ * Reservations that used up their runtime wait in 'throttled',
+ * ordered by the deadline at which they are replenished
+ */
+struct dl_rq
+{
+  struct rb_root      root;
+  struct rb_node      *leftmost;
+  int                 nr_running;
+
+  struct rb_root      throttled;
+  struct rb_node      *next_replenish;
+
+  u64                 total_bw;     // admitted, sum of runtime/period
+  u64                 max_bw;       // admission limit, all CPUs
+};
+
+
+/* Per-process state of the deadline class: a constant-bandwidth server */
+struct sched_dl_entity
+{
+  struct rb_node      node;         // keyed by deadline
+  u64                 dl_runtime;   // parameters, us
+  u64                 dl_deadline;
+  u64                 dl_period;
+  u64                 dl_bw;
+
+  long long           runtime;      // left in the current instance
+  u64                 deadline;     // absolute, us
+  uint                on_rq;        // on root, or throttled if dl_throttled
+  uint                dl_throttled;
+  uint                subtree_cpus; // cpus_allowed of node's subtree, ORed
+};
+
+
+/* The run queues of all scheduling classes */
+struct rq
+{
+  struct cfs_rq       cfs;
+  struct rt_rq        rt;
+  struct dl_rq        dl;
+  u64                 clock;        // us, updated every tick
+};
+
+
+/*
+ * Scheduling class
+ * Classes are consulted in priority order through 'next'; the first
+ * class with a runnable entity supplies the next process to run.
+ * A running entity is off its class's queue between set_curr and
+ * put_curr.
+ */
+struct sched_class
+{
+  const struct sched_class *next;
+
+  void  (*enqueue)(struct rq*, struct sched_entity*);
+  void  (*dequeue)(struct rq*, struct sched_entity*);
+  /* next entity allowed to run on the given CPU */
+  struct sched_entity* (*pick)(struct rq*, int);
+  void  (*set_curr)(struct rq*, struct sched_entity*);
+  void  (*put_curr)(struct rq*, struct sched_entity*);
+  /* account runtime to the running entity, every tick */
+  void  (*tick)(struct rq*, struct sched_entity*, u64);
+  /* should the running entity give way within its class? */
+  int   (*check_preempt)(struct rq*, struct sched_entity*);
+  /* the running entity yields: to anyone, or to the entity given
+   * (returns -1 if it cannot); either may be 0 */
+  void  (*yield)(struct rq*, struct sched_entity*);
+  int   (*yield_to)(struct rq*, struct sched_entity*, struct sched_entity*);
 };
 
 
@@ -59,8 +276,66 @@ struct sched_entity
   u64					tot_exec_runtime;
   u64					vruntime;
 
+  /* EEVDF */
+  u64					deadline;     // virtual deadline, vruntime + slice/weight
+  u64					min_deadline; // earliest deadline in run_node's subtree
+  u64					slice;        // requested slice, us
+  long long			vlag;         // lag saved when leaving the queue
+  uint				lag_saved;    // place by vlag on next enqueue
+
+  /* Affinity: a process may run on the CPUs in cpus_allowed;
+   * a group's mask is that of its queued members, ORed */
+  uint              cpus_allowed;
+  uint              subtree_cpus; // cpus_allowed of run_node's subtree, ORed
+  int               cpu;          // CPU running it, or that ran it last
+
   uint              on_rq;
-  struct cfs_rq	    *cfs_rq;
+  struct cfs_rq	    *cfs_rq;  // queue this entity is (or will be) on
+  struct sched_entity *parent; // group entity owning cfs_rq, 0 at root
+  struct cfs_rq     *my_q;    // group's own queue, 0 for a process
+
+  int               policy;
+  const struct sched_class *sched_class;
+  struct sched_rt_entity rt;
+  struct sched_dl_entity dl;
+
+  struct sched_avg  avg;    // fair class only
+};
+
+
+/*
+ * Task group
+ * A group schedules its members in its own cfs_rq, and competes
+ * in its parent's queue through one group entity whose weight is
+ * the group's shares. A group's entity is on its parent queue
+ * exactly while the group's own queue is non-empty and the group
+ * is not throttled.
+ * Runtime charged to a process is charged to every group above it.
+ *
+ * Bandwidth control: a group with a quota may use at most 'quota'
+ * us of CPU time (summed over all CPUs) per 'period' us. Once its
+ * runtime runs out it is throttled, i.e. taken off its parent
+ * queue, until the period timer refills it.
+ */
+struct task_group
+{
+  struct sched_entity	se;
+  struct cfs_rq			cfs_rq;
+  struct task_group		*parent;  // 0 if the parent is the root
+  uint					shares;
+  int					id;
+  int					used;
+
+  u64					quota;          // 0: unlimited
+  u64					period;
+  long long				runtime_remaining;
+  u64					period_end;     // next refill, in us
+  int					throttled;
+  u64					throttled_at;
+
+  uint					nr_periods;
+  uint					nr_throttled;
+  u64					throttled_time;
 };
 
 
@@ -71,9 +346,36 @@ u64		calc_delta(u64, uint, uint);
 u64		calc_slice(struct cfs_rq*, struct sched_entity*);
 u64		calc_delta_vslice(u64, struct sched_entity*);
 
-void 	update_entity_stat(struct cfs_rq*, u64);
+void 	update_entity_stat(struct sched_entity*, u64);
 void 	update_min_vruntime(struct cfs_rq*);
-int 	check_yield(struct cfs_rq*);
+int 	check_yield(struct sched_entity*);
+u64 	avg_vruntime(struct cfs_rq*);
+int 	entity_eligible(struct cfs_rq*, struct sched_entity*);
+struct sched_entity* pick_eevdf(struct cfs_rq*, struct sched_entity*);
+int 	throttled_entity(struct sched_entity*);
+void 	refill_group(struct task_group*, u64);
+
+extern const struct sched_class dl_sched_class;
+extern const struct sched_class rt_sched_class;
+extern const struct sched_class fair_sched_class;
+# define sched_class_highest	(&dl_sched_class)
+
+void  init_rq(struct rq*, int);
+void  init_sched_tunables(int);
+int   set_sched_tunables(struct sched_tunables*);
+void  refill_rt_rq(struct rt_rq*, u64);
+void  replenish_dl_rq(struct dl_rq*, u64);
+void  enqueue_task(struct rq*, struct sched_entity*);
+void  dequeue_task(struct rq*, struct sched_entity*);
+struct sched_entity* pick_next_task(struct rq*, int);
+void  set_curr_task(struct rq*, struct sched_entity*, int);
+void  put_curr_task(struct rq*, struct sched_entity*);
+int   check_preempt_curr(struct rq*, struct sched_entity*);
+void  yield_task(struct rq*, struct sched_entity*);
+int   yield_to_task(struct rq*, struct sched_entity*, struct sched_entity*);
+int   set_policy_entity(struct rq*, struct sched_entity*, struct sched_attr*);
+void  exit_task(struct rq*, struct sched_entity*);
+void  set_affinity_entity(struct rq*, struct sched_entity*, uint);
 
 void  clear_entity_stat(struct sched_entity*, u64);
 
@@ -0,0 +1,33 @@
+// Scheduling policies, for sched_setscheduler() and sched_setattr().
+#define SCHED_NORMAL    0   // CFS
+#define SCHED_FIFO      1   // real-time, run until blocked or preempted
+#define SCHED_RR        2   // real-time, round robin within a priority
+#define SCHED_BATCH     3   // CFS, CPU-bound: longer slices, no wakeup preemption
+#define SCHED_IDLE      5   // CFS, runs only when nothing else wants the CPU
+#define SCHED_DEADLINE  6   // EDF with a runtime/deadline/period reservation
+
+// Real-time priorities run from 1 (lowest) to MAX_RT_PRIO-1.
+#define MAX_RT_PRIO   100
+
+// Policy and parameters, for sched_setattr().
+// SCHED_DEADLINE: 'runtime' us of CPU every 'period' us, each by
+// 'deadline' us after the period starts; a period of 0 means
+// the same as the deadline. All in microseconds.
+struct sched_attr {
+  int policy;
+  int prio;         // SCHED_FIFO, SCHED_RR
+  uint runtime;     // SCHED_DEADLINE
+  uint deadline;
+  uint period;
+};
+
+// Fair scheduler tunables, for sched_gettunables() and
+// sched_settunables(). Defaults grow with 1 + log2(CPUs), up to 8
+// CPUs. All in microseconds.
+struct sched_tunables {
+  uint latency;           // period in which every task runs once
+  uint min_granularity;   // least a task runs before preemption
+  uint wakeup_granularity;// vruntime lead a waker needs to preempt
+  uint migration_cost;    // a task that ran this recently is cache-hot
+  uint log;               // scheduler debug output, 0 or 1
+};
@@ -0,0 +1,52 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "schedpolicy.h"
+
+// Show the scheduler tunables, or set one: schedtune [name value]
+
+struct tunable {
+  char *name;
+  uint *val;
+};
+
+int
+main(int argc, char **argv)
+{
+  struct sched_tunables t;
+  struct tunable tab[] = {
+    { "latency", &t.latency },
+    { "min_granularity", &t.min_granularity },
+    { "wakeup_granularity", &t.wakeup_granularity },
+    { "migration_cost", &t.migration_cost },
+    { "log", &t.log },
+  };
+  int i, n = sizeof(tab) / sizeof(tab[0]);
+
+  if(argc != 1 && argc != 3){
+    printf(2, "usage: schedtune [name value]\n");
+    exit();
+  }
+  if(sched_gettunables(&t) < 0){
+    printf(2, "schedtune: cannot read tunables\n");
+    exit();
+  }
+
+  if(argc == 1){
+    for(i = 0; i < n; i++)
+      printf(1, "%s %d\n", tab[i].name, *tab[i].val);
+    exit();
+  }
+
+  for(i = 0; i < n; i++)
+    if(strcmp(argv[1], tab[i].name) == 0)
+      break;
+  if(i == n){
+    printf(2, "schedtune: no tunable %s\n", argv[1]);
+    exit();
+  }
+  *tab[i].val = atoi(argv[2]);
+  if(sched_settunables(&t) < 0)
+    printf(2, "schedtune: %s %s out of range\n", argv[1], argv[2]);
+  exit();
+}
@@ -0,0 +1,120 @@
+// Slab-style object allocator layered on kalloc().
+// See slab.h.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "slab.h"
+
+void
+kmem_cache_init(struct kmem_cache *c, char *name, uint size)
+{
+  int i;
+
+  if(size < sizeof(struct slabobj))
+    size = sizeof(struct slabobj);
+  size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  if(size > PGSIZE)
+    panic("kmem_cache_init");
+
+  initlock(&c->lock, name);
+  c->name = name;
+  c->size = size;
+  c->freelist = 0;
+  c->npages = 0;
+  c->nfree = 0;
+  for(i = 0; i < NCPU; i++)
+    c->mag[i].n = 0;
+}
+
+// Carve a fresh page into objects on c->freelist.
+// Caller must hold c->lock.
+// Return 0 if there is no memory left.
+static int
+kmem_cache_grow(struct kmem_cache *c)
+{
+  char *page, *obj;
+  struct slabobj *o;
+
+  if((page = kalloc()) == 0)
+    return 0;
+
+  for(obj = page; obj + c->size <= page + PGSIZE; obj += c->size){
+    o = (struct slabobj*)obj;
+    o->next = c->freelist;
+    c->freelist = o;
+    c->nfree++;
+  }
+  c->npages++;
+  return 1;
+}
+
+// Allocate one object from c. Contents are undefined.
+// Returns 0 if the memory cannot be allocated.
+void*
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct magazine *m;
+  struct slabobj *o;
+  void *obj;
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n > 0){
+    obj = m->objs[--m->n];
+    popcli();
+    return obj;
+  }
+  popcli();
+
+  // Magazine empty: refill half of it from the shared free list.
+  // Holding c->lock keeps interrupts off, so we stay on this CPU.
+  acquire(&c->lock);
+  m = &c->mag[cpuid()];
+  if(c->freelist == 0 && !kmem_cache_grow(c)){
+    release(&c->lock);
+    return 0;
+  }
+  while(m->n < MAGSIZE/2 && c->nfree > 1){
+    o = c->freelist;
+    c->freelist = o->next;
+    c->nfree--;
+    m->objs[m->n++] = o;
+  }
+  o = c->freelist;
+  c->freelist = o->next;
+  c->nfree--;
+  release(&c->lock);
+  return o;
+}
+
+// Return obj, which came from kmem_cache_alloc(c), to c.
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct magazine *m;
+  struct slabobj *o;
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n < MAGSIZE){
+    m->objs[m->n++] = obj;
+    popcli();
+    return;
+  }
+
+  // Magazine full: spill half of it to the shared free list.
+  acquire(&c->lock);
+  while(m->n > MAGSIZE/2){
+    o = m->objs[--m->n];
+    o->next = c->freelist;
+    c->freelist = o;
+    c->nfree++;
+  }
+  m->objs[m->n++] = obj;
+  release(&c->lock);
+  popcli();
+}
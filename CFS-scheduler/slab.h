@@ -0,0 +1,30 @@
+// Object caches for small, fixed-size kernel structures.
+//
+// A cache carves whole pages from kalloc() into objects of one
+// size and keeps them on a free list protected by its spinlock.
+// In front of that, every CPU has a small magazine of free objects
+// it can take from or return to with only interrupts disabled, so
+// most allocations never touch the shared lock.
+// Pages are never handed back to kalloc().
+
+#define MAGSIZE 16   // objects cached per CPU
+
+struct slabobj {
+  struct slabobj *next;
+};
+
+struct magazine {
+  int n;                     // number of objects in objs
+  void *objs[MAGSIZE];
+};
+
+struct kmem_cache {
+  struct spinlock lock;      // protects freelist and counters
+  char *name;                // For debugging
+  uint size;                 // object size in bytes
+  struct slabobj *freelist;  // free objects not in any magazine
+  uint npages;               // pages carved so far
+  uint nfree;                // objects on freelist
+  struct magazine mag[NCPU]; // per-CPU free objects
+};
+
@@ -16,29 +16,164 @@ initsleeplock(struct sleeplock *lk, char *name)
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->readers = 0;
+  lk->head = 0;
+  lk->tail = 0;
   lk->pid = 0;
 }
 
+// Append w to the wait queue and sleep until a releaser
+// hands the lock over. Caller must hold lk->lk.
+static void
+waitsleep(struct sleeplock *lk, struct sleepwaiter *w, int shared)
+{
+  w->next = 0;
+  w->shared = shared;
+  w->granted = 0;
+  w->pid = myproc()->pid;
+
+  if(lk->tail)
+    lk->tail->next = w;
+  else
+    lk->head = w;
+  lk->tail = w;
+
+  // Each waiter sleeps on its own queue node, so a hand-off
+  // wakes only the process it was meant for.
+  while(!w->granted)
+    sleep(w, &lk->lk);
+}
+
+// Hand the lock to the head of the wait queue if it can run:
+// either one writer, or every reader up to the next writer.
+// Caller must hold lk->lk.
+static void
+grantsleep(struct sleeplock *lk)
+{
+  struct sleepwaiter *w;
+
+  if(lk->locked || (w = lk->head) == 0)
+    return;
+
+  if(!w->shared){
+    if(lk->readers)
+      return;
+    if((lk->head = w->next) == 0)
+      lk->tail = 0;
+    lk->locked = 1;
+    lk->pid = w->pid;
+    w->granted = 1;
+    wakeup(w);
+    return;
+  }
+
+  while(w && w->shared){
+    if((lk->head = w->next) == 0)
+      lk->tail = 0;
+    lk->readers++;
+    w->granted = 1;
+    wakeup(w);
+    w = lk->head;
+  }
+}
+
+// Readers are counted in the lock; each process also keeps the
+// locks it holds shared, so a release can be checked against them.
+static void
+addshared(struct sleeplock *lk)
+{
+  struct proc *p = myproc();
+
+  if(p->nshared == NSHARED)
+    panic("addshared");
+  p->shared[p->nshared++] = lk;
+}
+
+static int
+findshared(struct sleeplock *lk)
+{
+  struct proc *p = myproc();
+  int i;
+
+  for(i = 0; i < p->nshared; i++)
+    if(p->shared[i] == lk)
+      return i;
+  return -1;
+}
+
 void
 acquiresleep(struct sleeplock *lk)
 {
+  struct sleepwaiter w;
+
   acquire(&lk->lk);
-  while (lk->locked) {
-    sleep(lk, &lk->lk);
+  if(lk->locked || lk->readers || lk->head){
+    waitsleep(lk, &w, 0);
+  } else {
+    lk->locked = 1;
+    lk->pid = myproc()->pid;
   }
-  lk->locked = 1;
-  lk->pid = myproc()->pid;
   release(&lk->lk);
 }
 
+// Acquire lk for reading. Readers do not barge past queued
+// waiters, so a writer cannot be starved by a stream of readers.
+void
+acquiresleepshared(struct sleeplock *lk)
+{
+  struct sleepwaiter w;
+
+  acquire(&lk->lk);
+  if(lk->locked || lk->head)
+    waitsleep(lk, &w, 1);
+  else
+    lk->readers++;
+  release(&lk->lk);
+  addshared(lk);
+}
+
 void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
   lk->locked = 0;
   lk->pid = 0;
-  wakeup(lk);
+  grantsleep(lk);
+  release(&lk->lk);
+}
+
+void
+releasesleepshared(struct sleeplock *lk)
+{
+  struct proc *p = myproc();
+  int i;
+
+  if((i = findshared(lk)) < 0)
+    panic("releasesleepshared");
+  p->shared[i] = p->shared[--p->nshared];
+
+  acquire(&lk->lk);
+  if(lk->readers == 0)
+    panic("releasesleepshared");
+  lk->readers--;
+  grantsleep(lk);
+  release(&lk->lk);
+}
+
+// Turn an exclusive hold into a shared one, letting any
+// readers queued at the head in alongside the caller.
+void
+downgradesleep(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  if(!lk->locked || lk->pid != myproc()->pid)
+    panic("downgradesleep");
+  lk->locked = 0;
+  lk->pid = 0;
+  lk->readers++;
+  grantsleep(lk);
   release(&lk->lk);
+  addshared(lk);
 }
 
 int
@@ -52,5 +187,12 @@ holdingsleep(struct sleeplock *lk)
   return r;
 }
 
+// Does this process hold lk shared?
+int
+holdingsleepshared(struct sleeplock *lk)
+{
+  return findshared(lk) >= 0;
+}
+
 
 
@@ -1,10 +1,29 @@
 // Long-term locks for processes
+//
+// A sleeplock may be held exclusively by one process (a writer)
+// or shared by any number of readers. Waiters queue in FIFO order
+// and are handed the lock directly on release, so a release wakes
+// exactly one writer or the run of readers at the head of the queue.
+
+// Queue node for a process blocked on a sleeplock.
+// Lives on the waiting process's kernel stack.
+struct sleepwaiter {
+  struct sleepwaiter *next;
+  int shared;        // Waiting for shared (read) access?
+  int granted;       // Set by the releaser on hand-off
+  int pid;           // Waiting process
+};
+
 struct sleeplock {
-  uint locked;       // Is the lock held?
+  uint locked;       // Is the lock held exclusively?
+  uint readers;      // Number of shared holders
   struct spinlock lk; // spinlock protecting this sleep lock
-  
+
+  struct sleepwaiter *head;   // FIFO of blocked processes
+  struct sleepwaiter *tail;
+
   // For debugging:
   char *name;        // Name of lock.
-  int pid;           // Process holding lock
+  int pid;           // Process holding lock exclusively
 };
 
@@ -0,0 +1,62 @@
+// Null system call round trip: int $T_SYSCALL versus sysenter.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "syscall.h"
+#include "traps.h"
+
+#define LOGN 16  // 2^LOGN calls, so no 64-bit division is needed
+#define N (1<<LOGN)
+
+static inline u64
+rdtsc(void)
+{
+  u64 t;
+  asm volatile("rdtsc" : "=A" (t));
+  return t;
+}
+
+// The call returns in %eax, so it is an in/out operand.
+static void
+getpid_int(void)
+{
+  int ret = SYS_getpid;
+
+  asm volatile("int %1" : "+a" (ret) : "i" (T_SYSCALL)
+               : "memory");
+}
+
+static void
+getpid_sysenter(void)
+{
+  int ret = SYS_getpid;
+
+  asm volatile("movl %%esp, %%ecx\n\t"
+               "movl $1f, %%edx\n\t"
+               "sysenter\n"
+               "1:"
+               : "+a" (ret) : : "ecx", "edx", "memory");
+}
+
+static void
+run(char *name, void (*call)(void))
+{
+  u64 start, cycles;
+  int i;
+
+  call();  // warm up
+  start = rdtsc();
+  for(i = 0; i < N; i++)
+    call();
+  cycles = rdtsc() - start;
+  printf(1, "%s: %d cycles per call\n", name, (uint)(cycles >> LOGN));
+}
+
+int
+main(int argc, char *argv[])
+{
+  run("int", getpid_int);
+  run("sysenter", getpid_sysenter);
+  exit();
+}
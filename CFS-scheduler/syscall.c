@@ -107,6 +107,26 @@ extern int sys_uptime(void);
 extern int sys_getnice(void);
 extern int sys_setnice(void);
 extern int sys_forknice(void);
+extern int sys_tgcreate(void);
+extern int sys_tgattach(void);
+extern int sys_tgsetshares(void);
+extern int sys_tgsetbandwidth(void);
+extern int sys_tgstat(void);
+extern int sys_sched_setscheduler(void);
+extern int sys_sched_getscheduler(void);
+extern int sys_setslice(void);
+extern int sys_sched_setattr(void);
+extern int sys_sched_setaffinity(void);
+extern int sys_sched_getaffinity(void);
+extern int sys_getloadavg(void);
+extern int sys_sched_gettunables(void);
+extern int sys_sched_settunables(void);
+extern int sys_sched_yield(void);
+extern int sys_yield_to(void);
+extern int sys_ring_setup(void);
+extern int sys_ring_enter(void);
+extern int sys_fsync(void);
+extern int sys_irq_setaffinity(void);
 
 
 static int (*syscalls[])(void) = {
@@ -134,6 +154,26 @@ static int (*syscalls[])(void) = {
 [SYS_getnice]     sys_getnice,
 [SYS_setnice]     sys_setnice,
 [SYS_forknice]    sys_forknice,
+[SYS_tgcreate]    sys_tgcreate,
+[SYS_tgattach]    sys_tgattach,
+[SYS_tgsetshares] sys_tgsetshares,
+[SYS_tgsetbandwidth] sys_tgsetbandwidth,
+[SYS_tgstat]      sys_tgstat,
+[SYS_sched_setscheduler] sys_sched_setscheduler,
+[SYS_sched_getscheduler] sys_sched_getscheduler,
+[SYS_setslice]    sys_setslice,
+[SYS_sched_setattr] sys_sched_setattr,
+[SYS_sched_setaffinity] sys_sched_setaffinity,
+[SYS_sched_getaffinity] sys_sched_getaffinity,
+[SYS_getloadavg]  sys_getloadavg,
+[SYS_sched_gettunables] sys_sched_gettunables,
+[SYS_sched_settunables] sys_sched_settunables,
+[SYS_sched_yield] sys_sched_yield,
+[SYS_yield_to]    sys_yield_to,
+[SYS_ring_setup]  sys_ring_setup,
+[SYS_ring_enter]  sys_ring_enter,
+[SYS_fsync]       sys_fsync,
+[SYS_irq_setaffinity] sys_irq_setaffinity,
 };
 
 void
@@ -22,4 +22,24 @@
 #define SYS_close  21
 #define SYS_getnice     22
 #define SYS_setnice     23
-#define SYS_forknice    24
\ No newline at end of file
+#define SYS_forknice    24
+#define SYS_tgcreate    25
+#define SYS_tgattach    26
+#define SYS_tgsetshares 27
+#define SYS_tgsetbandwidth 28
+#define SYS_tgstat      29
+#define SYS_sched_setscheduler 30
+#define SYS_sched_getscheduler 31
+#define SYS_setslice    32
+#define SYS_sched_setattr 33
+#define SYS_sched_setaffinity 34
+#define SYS_sched_getaffinity 35
+#define SYS_getloadavg  36
+#define SYS_sched_gettunables 37
+#define SYS_sched_settunables 38
+#define SYS_sched_yield 39
+#define SYS_yield_to    40
+#define SYS_ring_setup  41
+#define SYS_ring_enter  42
+#define SYS_fsync       43
+#define SYS_irq_setaffinity 44
@@ -15,6 +15,20 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "ring.h"
+
+// Return the struct file open as fd.
+static int
+fdfile(int fd, struct file **pf)
+{
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+    return -1;
+  if(pf)
+    *pf = f;
+  return 0;
+}
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -22,16 +36,11 @@ static int
 argfd(int n, int *pfd, struct file **pf)
 {
   int fd;
-  struct file *f;
 
-  if(argint(n, &fd) < 0)
-    return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if(argint(n, &fd) < 0 || fdfile(fd, pf) < 0)
     return -1;
   if(pfd)
     *pfd = fd;
-  if(pf)
-    *pf = f;
   return 0;
 }
 
@@ -90,19 +99,28 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
-int
-sys_close(void)
+static int
+fdclose(int fd)
 {
-  int fd;
   struct file *f;
 
-  if(argfd(0, &fd, &f) < 0)
+  if(fdfile(fd, &f) < 0)
     return -1;
   myproc()->ofile[fd] = 0;
   fileclose(f);
   return 0;
 }
 
+int
+sys_close(void)
+{
+  int fd;
+
+  if(argint(0, &fd) < 0)
+    return -1;
+  return fdclose(fd);
+}
+
 int
 sys_fstat(void)
 {
@@ -114,6 +132,17 @@ sys_fstat(void)
   return filestat(f, st);
 }
 
+// Wait until what has been written to the file is on disk.
+int
+sys_fsync(void)
+{
+  struct file *f;
+
+  if(argfd(0, 0, &f) < 0)
+    return -1;
+  return filesync(f);
+}
+
 // Create the path new as a link to the same inode as old.
 int
 sys_link(void)
@@ -267,32 +296,39 @@ create(char *path, short type, short major, short minor)
   iupdate(ip);
 
   if(type == T_DIR){  // Create . and .. entries.
-    dp->nlink++;  // for ".."
-    iupdate(dp);
     // No ip->nlink++ for ".": avoid cyclic ref count.
     if(dirlink(ip, ".", ip->inum) < 0 || dirlink(ip, "..", dp->inum) < 0)
-      panic("create dots");
+      goto fail;
   }
 
   if(dirlink(dp, name, ip->inum) < 0)
-    panic("create: dirlink");
+    goto fail;
+
+  if(type == T_DIR){
+    dp->nlink++;  // for ".."
+    iupdate(dp);
+  }
 
   iunlockput(dp);
 
   return ip;
+
+fail:
+  // Out of disk space: free ip again.
+  ip->nlink = 0;
+  iupdate(ip);
+  iunlockput(ip);
+  iunlockput(dp);
+  return 0;
 }
 
-int
-sys_open(void)
+static int
+openpath(char *path, int omode)
 {
-  char *path;
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
 
-  if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
-    return -1;
-
   begin_op();
 
   if(omode & O_CREATE){
@@ -332,6 +368,17 @@ sys_open(void)
   return fd;
 }
 
+int
+sys_open(void)
+{
+  char *path;
+  int omode;
+
+  if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return openpath(path, omode);
+}
+
 int
 sys_mkdir(void)
 {
@@ -442,3 +489,89 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+// Is [addr, addr+n) within the current process?
+static int
+userrange(uint addr, int n)
+{
+  uint sz = myproc()->sz;
+
+  return n >= 0 && addr < sz && n <= sz - addr;
+}
+
+// Run one submitted operation as its system call would.
+static int
+ringop(struct ring_sqe *sqe)
+{
+  struct file *f;
+  char *path;
+
+  switch(sqe->op){
+  case RING_OP_NOP:
+    return 0;
+  case RING_OP_READ:
+    if(fdfile(sqe->fd, &f) < 0 || !userrange(sqe->addr, sqe->len))
+      return -1;
+    return fileread(f, (char*)sqe->addr, sqe->len);
+  case RING_OP_WRITE:
+    if(fdfile(sqe->fd, &f) < 0 || !userrange(sqe->addr, sqe->len))
+      return -1;
+    return filewrite(f, (char*)sqe->addr, sqe->len);
+  case RING_OP_FSYNC:
+    if(fdfile(sqe->fd, &f) < 0)
+      return -1;
+    return filesync(f);
+  case RING_OP_OPEN:
+    if(fetchstr(sqe->addr, &path) < 0)
+      return -1;
+    return openpath(path, sqe->len);
+  case RING_OP_CLOSE:
+    return fdclose(sqe->fd);
+  }
+  return -1;
+}
+
+// Register the ring at addr for ring_enter(), emptying it.
+int
+sys_ring_setup(void)
+{
+  struct ring *r;
+
+  if(argptr(0, (void*)&r, sizeof(*r)) < 0)
+    return -1;
+  r->sq_head = r->sq_tail = 0;
+  r->cq_head = r->cq_tail = 0;
+  myproc()->ring = (uint)r;
+  return 0;
+}
+
+// Run up to n submitted operations, as long as their completions
+// fit. Returns how many were run: one trap for the whole batch.
+int
+sys_ring_enter(void)
+{
+  struct proc *curproc = myproc();
+  struct ring *r = (struct ring*)curproc->ring;
+  struct ring_sqe sqe;
+  struct ring_cqe *cqe;
+  int n, done;
+
+  if(argint(0, &n) < 0 || r == 0)
+    return -1;
+  // The ring may have been unmapped by sbrk() since ring_setup().
+  if(!userrange((uint)r, sizeof(*r)))
+    return -1;
+
+  for(done = 0; done < n && !curproc->killed; done++){
+    if(r->sq_head == r->sq_tail || r->cq_tail - r->cq_head >= RING_ENTRIES)
+      break;
+    sqe = r->sq[r->sq_head % RING_ENTRIES];
+    r->sq_head++;
+
+    cqe = &r->cq[r->cq_tail % RING_ENTRIES];
+    cqe->user_data = sqe.user_data;
+    cqe->res = ringop(&sqe);
+    r->cq_tail++;
+  }
+  return done;
+}
@@ -6,6 +6,8 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "tgstat.h"
+#include "loadavg.h"
 
 int
 sys_fork(void)
@@ -59,22 +61,16 @@ sys_sbrk(void)
 int
 sys_sleep(void)
 {
-  int n;
-  uint ticks0;
+  int n, r;
 
   if(argint(0, &n) < 0)
     return -1;
+  if(n <= 0)
+    return 0;
   acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
+  r = timer_sleep(us + (u64)n * 1000);
   release(&tickslock);
-  return 0;
+  return r;
 }
 
 // return how many clock tick interrupts have occurred
@@ -119,4 +115,176 @@ sys_forknice(void)
     return -1;
 
   return forknice(nice);
-}
\ No newline at end of file
+}
+
+int
+sys_tgcreate(void)
+{
+  int parent;
+  if(argint(0, &parent) < 0)
+    return -1;
+
+  return tgcreate(parent);
+}
+
+int
+sys_tgattach(void)
+{
+  int pid, id;
+  if(argint(0, &pid) < 0 || argint(1, &id) < 0)
+    return -1;
+
+  return tgattach(pid, id);
+}
+
+int
+sys_tgsetshares(void)
+{
+  int id, shares;
+  if(argint(0, &id) < 0 || argint(1, &shares) < 0)
+    return -1;
+
+  return tgsetshares(id, shares);
+}
+
+int
+sys_tgsetbandwidth(void)
+{
+  int id, quota, period;
+  if(argint(0, &id) < 0 || argint(1, &quota) < 0 || argint(2, &period) < 0)
+    return -1;
+
+  return tgsetbandwidth(id, quota, period);
+}
+
+int
+sys_tgstat(void)
+{
+  int id;
+  struct tgstat *st;
+  if(argint(0, &id) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+
+  return tgstat(id, st);
+}
+
+int
+sys_sched_setscheduler(void)
+{
+  int pid, policy, prio;
+  if(argint(0, &pid) < 0 || argint(1, &policy) < 0 || argint(2, &prio) < 0)
+    return -1;
+
+  return sched_setscheduler(pid, policy, prio);
+}
+
+int
+sys_sched_getscheduler(void)
+{
+  int pid;
+  if(argint(0, &pid) < 0)
+    return -1;
+
+  return sched_getscheduler(pid);
+}
+
+int
+sys_setslice(void)
+{
+  int us;
+  if(argint(0, &us) < 0)
+    return -1;
+
+  return setslice(us);
+}
+
+int
+sys_sched_setattr(void)
+{
+  int pid;
+  struct sched_attr *attr;
+  if(argint(0, &pid) < 0 || argptr(1, (void*)&attr, sizeof(*attr)) < 0)
+    return -1;
+
+  return sched_setattr(pid, attr);
+}
+
+int
+sys_sched_setaffinity(void)
+{
+  int pid, mask;
+  if(argint(0, &pid) < 0 || argint(1, &mask) < 0)
+    return -1;
+
+  return sched_setaffinity(pid, (uint)mask);
+}
+
+// Route device interrupt irq to CPU cpu.
+int
+sys_irq_setaffinity(void)
+{
+  int irq, cpu;
+  if(argint(0, &irq) < 0 || argint(1, &cpu) < 0)
+    return -1;
+  if(cpu < 0 || cpu >= ncpu)
+    return -1;
+
+  return ioapicroute(irq, cpus[cpu].apicid);
+}
+
+int
+sys_sched_getaffinity(void)
+{
+  int pid;
+  if(argint(0, &pid) < 0)
+    return -1;
+
+  return sched_getaffinity(pid);
+}
+
+int
+sys_getloadavg(void)
+{
+  int pid;
+  struct loadavg *la;
+  if(argint(0, &pid) < 0 || argptr(1, (void*)&la, sizeof(*la)) < 0)
+    return -1;
+
+  return getloadavg(pid, la);
+}
+
+int
+sys_sched_gettunables(void)
+{
+  struct sched_tunables *t;
+  if(argptr(0, (void*)&t, sizeof(*t)) < 0)
+    return -1;
+
+  return sched_gettunables(t);
+}
+
+int
+sys_sched_settunables(void)
+{
+  struct sched_tunables *t;
+  if(argptr(0, (void*)&t, sizeof(*t)) < 0)
+    return -1;
+
+  return sched_settunables(t);
+}
+
+int
+sys_sched_yield(void)
+{
+  return sched_yield();
+}
+
+int
+sys_yield_to(void)
+{
+  int pid;
+  if(argint(0, &pid) < 0)
+    return -1;
+
+  return yield_to(pid);
+}
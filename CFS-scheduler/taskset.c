@@ -0,0 +1,27 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+// Run a command on the CPUs in mask, bit i standing for CPU i,
+// or with -i, route device interrupt irq to CPU cpu.
+int
+main(int argc, char **argv)
+{
+  if(argc == 4 && strcmp(argv[1], "-i") == 0){
+    if(irq_setaffinity(atoi(argv[2]), atoi(argv[3])) < 0)
+      printf(2, "taskset: cannot route irq %s to cpu %s\n", argv[2], argv[3]);
+    exit();
+  }
+  if(argc < 3){
+    printf(2, "usage: taskset mask cmd [arg...]\n"
+              "       taskset -i irq cpu\n");
+    exit();
+  }
+  if(sched_setaffinity(0, atoi(argv[1])) < 0){
+    printf(2, "taskset: bad mask %s\n", argv[1]);
+    exit();
+  }
+  exec(argv[2], argv + 2);
+  printf(2, "taskset: exec %s failed\n", argv[2]);
+  exit();
+}
@@ -0,0 +1,12 @@
+// Task group statistics, filled in by tgstat().
+struct tgstat {
+  uint shares;        // CPU shares (weight)
+  uint quota_us;      // Runtime allowed per period, 0 if unlimited
+  uint period_us;     // Bandwidth period
+  uint nr_periods;    // Periods elapsed with a quota set
+  uint nr_throttled;  // Times the group ran out of quota
+  uint throttled_ms;  // Total time spent throttled
+  uint runtime_ms;    // Total CPU time used by members
+  uint load_avg;      // Decaying averages of the group's queue,
+  uint util_avg;      // as in loadavg.h
+};
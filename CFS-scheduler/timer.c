@@ -0,0 +1,103 @@
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "timer.h"
+
+// rbtree.c
+extern void rb_insert(struct rb_node*, struct rb_root*);
+extern void rb_delete(struct rb_node*, struct rb_root*);
+extern struct rb_node* rb_leftmost(struct rb_root*);
+
+
+/* Pending timers, protected by tickslock */
+struct {
+  struct rb_root	root;
+  struct rb_node	*leftmost;
+} timers;
+
+
+/* ----- Timer queue modification ----- */
+
+/*
+ * Arm t to fire at absolute time 'expires' (us)
+ * Caller must hold tickslock
+ */
+void
+timer_add(struct timer *t, u64 expires)
+{
+  if(t->pending)
+    panic("timer_add");
+
+  t->expires = expires;
+  t->node.key = expires;
+  rb_insert(&t->node, &timers.root);
+  t->pending = 1;
+
+  timers.leftmost = rb_leftmost(&timers.root);
+}
+
+
+/*
+ * Disarm t if it has not fired yet
+ * Caller must hold tickslock
+ */
+void
+timer_del(struct timer *t)
+{
+  if(!t->pending)
+    return;
+
+  rb_delete(&t->node, &timers.root);
+  t->pending = 0;
+
+  timers.leftmost = rb_leftmost(&timers.root);
+}
+
+
+/*
+ * Fire every timer whose deadline is not after 'now'
+ * Called from the timer interrupt with tickslock held
+ * Costs nothing while the earliest deadline is in the future
+ */
+void
+timer_run(u64 now)
+{
+  struct timer *t;
+
+  while(timers.leftmost) {
+    t = rb_entry(timers.leftmost, struct timer, node);
+    if(t->expires > now)
+      break;
+
+    timer_del(t);
+    wakeup(t);
+  }
+}
+
+
+/*
+ * Sleep until absolute time 'expires' (us)
+ * Caller must hold tickslock
+ * Returns -1 if the process was killed before the deadline
+ */
+int
+timer_sleep(u64 expires)
+{
+  struct timer t;
+
+  t.pending = 0;
+  timer_add(&t, expires);
+
+  while(t.pending) {
+    if(myproc()->killed) {
+      timer_del(&t);
+      return -1;
+    }
+    sleep(&t, &tickslock);
+  }
+  return 0;
+}
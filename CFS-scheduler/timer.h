@@ -0,0 +1,24 @@
+#ifndef TIMER_H
+# define TIMER_H
+
+// timer.h
+# include "rbtree.h"
+# include "types.h"
+
+/*
+ * One-shot kernel timer.
+ * Pending timers sit in an rbtree keyed by their absolute
+ * deadline in 'us', so the timer interrupt only looks at
+ * the leftmost (earliest) node, and a sleeper is woken
+ * exactly once, when its deadline passes.
+ * Keys are in us rather than ticks, so a finer clock source
+ * only has to call timer_run() more often.
+ */
+struct timer
+{
+  struct rb_node	node;
+  u64				expires;	// absolute deadline, in us
+  int				pending;	// in the tree, not fired yet
+};
+
+#endif
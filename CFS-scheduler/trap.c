@@ -7,6 +7,7 @@
 #include "x86.h"
 #include "traps.h"
 #include "spinlock.h"
+#include "vdso.h"
 
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
@@ -38,10 +39,81 @@ idtinit(void)
   lidt(idt, sizeof(idt));
 }
 
+// Let user space enter system calls with sysenter on this CPU.
+// sysenter loads %esp from the MSR; it is pointed at this CPU's
+// ts.esp0, which switchuvm() keeps at the top of the running
+// process's kernel stack, and sysenter_entry loads it from there.
+void
+sysenterinit(void)
+{
+  extern char sysenter_entry[];
+  uint eax, ebx, ecx, edx;
+
+  readcpuid(1, &eax, &ebx, &ecx, &edx);
+  if(!(edx & CPUID_SEP))
+    return;
+  wrmsr(MSR_SYSENTER_CS, SEG_KCODE<<3, 0);
+  wrmsr(MSR_SYSENTER_ESP, (uint)&mycpu()->ts.esp0, 0);
+  wrmsr(MSR_SYSENTER_EIP, (uint)sysenter_entry, 0);
+}
+
+// Publish the clock in the vDSO page, on every tick.
+// The TSC rate is measured over VDSO_CALIB_TICKS ticks, so that
+// user space can interpolate between ticks.
+#define VDSO_CALIB_TICKS 256
+
+static void
+vdsotick(void)
+{
+  static u64 calib_tsc;
+  static uint calib_ticks;
+  u64 tsc = rdtsc();
+  uint cycles;
+
+  vdso->seq++;
+  __sync_synchronize();
+
+  if(calib_ticks == 0)
+    calib_tsc = tsc;
+  if(++calib_ticks > VDSO_CALIB_TICKS){
+    cycles = tsc - calib_tsc;
+    if(cycles)
+      vdso->tsc_mult = div_u64((u64)VDSO_CALIB_TICKS * 1000 << VDSO_MULT_SHIFT,
+                               cycles);
+    calib_ticks = 0;
+  }
+  vdso->ticks = ticks;
+  vdso->us = us;
+  vdso->tsc = tsc;
+
+  __sync_synchronize();
+  vdso->seq++;
+}
+
+// Did user space fault on a sysenter instruction?
+static int
+sysenterfault(struct trapframe *tf)
+{
+  struct proc *p = myproc();
+
+  if(tf->trapno != T_ILLOP || (tf->cs&3) != DPL_USER || p == 0)
+    return 0;
+  if(tf->eip >= p->sz || p->sz - tf->eip < 2)
+    return 0;
+  return *(ushort*)tf->eip == 0x340f;
+}
+
 //PAGEBREAK: 41
 void
 trap(struct trapframe *tf)
 {
+  // Without sysenter, the call traps here instead: make it look
+  // like int $T_SYSCALL, returning where sysenter would (%edx)
+  if(sysenterfault(tf)){
+    tf->trapno = T_SYSCALL;
+    tf->eip = tf->edx;
+  }
+
   if(tf->trapno == T_SYSCALL){
     if(myproc()->killed)
       exit();
@@ -58,8 +130,10 @@ trap(struct trapframe *tf)
       acquire(&tickslock);
       ticks++;
 	    us += 1000;
-      wakeup(&ticks);
+      vdsotick();
+      timer_run(us);
       release(&tickslock);
+      bwrefill(us);
     }
     lapiceoi();
     break;
@@ -3,6 +3,8 @@
 #include "fcntl.h"
 #include "user.h"
 #include "x86.h"
+#include "memlayout.h"
+#include "vdso.h"
 
 char*
 strcpy(char *s, const char *t)
@@ -104,3 +106,44 @@ memmove(void *vdst, const void *vsrc, int n)
     *dst++ = *src++;
   return vdst;
 }
+
+// Clock and pid from the vDSO pages, without a system call.
+
+int
+getpid(void)
+{
+  return ((struct vdso_proc*)VDSO_PROC)->pid;
+}
+
+int
+uptime(void)
+{
+  return ((struct vdso_data*)VDSO_DATA)->ticks;
+}
+
+// Microseconds since boot: the clock at the last tick, plus the
+// time since then by the TSC, at most one tick's worth.
+u64
+uptime_us(void)
+{
+  struct vdso_data *vd = (struct vdso_data*)VDSO_DATA;
+  uint seq, mult, delta;
+  u64 us, tsc;
+
+  do {
+    seq = vd->seq;
+    asm volatile("" ::: "memory");
+    us = vd->us;
+    tsc = vd->tsc;
+    mult = vd->tsc_mult;
+    asm volatile("" ::: "memory");
+  } while((seq & 1) || seq != vd->seq);
+
+  delta = 0;
+  if(mult){
+    delta = ((u64)(uint)(rdtsc() - tsc) * mult) >> VDSO_MULT_SHIFT;
+    if(delta > 999)
+      delta = 999;
+  }
+  return us + delta;
+}
@@ -1,5 +1,7 @@
 struct stat;
 struct rtcdate;
+struct tgstat;
+struct loadavg;
 
 // system calls
 int fork(void);
@@ -19,17 +21,41 @@ int link(const char*, const char*);
 int mkdir(const char*);
 int chdir(const char*);
 int dup(int);
-int getpid(void);
 char* sbrk(int);
 int sleep(int);
-int uptime(void);
 
 int getnice(void);
 int setnice(int);
 int forknice(int);
+int setslice(int);
+int tgcreate(int);
+int tgattach(int, int);
+int tgsetshares(int, int);
+int tgsetbandwidth(int, int, int);
+int tgstat(int, struct tgstat*);
+int sched_setscheduler(int, int, int);
+int sched_getscheduler(int);
+struct sched_attr;
+int sched_setattr(int, struct sched_attr*);
+int sched_setaffinity(int, uint);
+int sched_getaffinity(int);
+int getloadavg(int, struct loadavg*);
+struct sched_tunables;
+int sched_gettunables(struct sched_tunables*);
+int sched_settunables(struct sched_tunables*);
+int sched_yield(void);
+int yield_to(int);
+struct ring;
+int ring_setup(struct ring*);
+int ring_enter(int);
+int fsync(int);
+int irq_setaffinity(int, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
+int getpid(void);   // from the vDSO pages (vdso.h)
+int uptime(void);
+u64 uptime_us(void);
 char* strcpy(char*, const char*);
 void *memmove(void*, const void*, int);
 char* strchr(const char*, char c);
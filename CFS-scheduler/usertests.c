@@ -7,6 +7,7 @@
 #include "syscall.h"
 #include "traps.h"
 #include "memlayout.h"
+#include "ring.h"
 
 char buf[8192];
 char name[3];
@@ -184,10 +185,13 @@ writetest(void)
   printf(stdout, "small file test ok\n");
 }
 
+// Write the largest file the image's block size allows, one
+// block at a time, and check that it cannot grow any further.
 void
 writetest1(void)
 {
-  int i, fd, n;
+  int i, fd, n, bs, maxfile;
+  struct stat st;
 
   printf(stdout, "big files test\n");
 
@@ -196,14 +200,24 @@ writetest1(void)
     printf(stdout, "error: creat big failed!\n");
     exit();
   }
+  if(fstat(fd, &st) < 0 || st.blksize > sizeof(buf)){
+    printf(stdout, "error: fstat big failed!\n");
+    exit();
+  }
+  bs = st.blksize;
+  maxfile = NDIRECT + bs / sizeof(uint);
 
-  for(i = 0; i < MAXFILE; i++){
+  for(i = 0; i < maxfile; i++){
     ((int*)buf)[0] = i;
-    if(write(fd, buf, 512) != 512){
-      printf(stdout, "error: write big file failed\n", i);
+    if(write(fd, buf, bs) != bs){
+      printf(stdout, "error: write big file failed %d\n", i);
       exit();
     }
   }
+  if(write(fd, buf, 1) >= 0){
+    printf(stdout, "error: write past MAXFILE succeeded\n");
+    exit();
+  }
 
   close(fd);
 
@@ -215,14 +229,14 @@ writetest1(void)
 
   n = 0;
   for(;;){
-    i = read(fd, buf, 512);
+    i = read(fd, buf, bs);
     if(i == 0){
-      if(n == MAXFILE - 1){
+      if(n != maxfile){
         printf(stdout, "read only %d blocks from big", n);
         exit();
       }
       break;
-    } else if(i != 512){
+    } else if(i != bs){
       printf(stdout, "read failed %d\n", i);
       exit();
     }
@@ -264,6 +278,47 @@ createtest(void)
   printf(stdout, "many creates, followed by unlink; ok\n");
 }
 
+// Create and unlink one file many more times than there are
+// inodes (200, see mkfs.c): ialloc() hands out inode numbers from
+// a rotor, so they must wrap around, and every unlink must free
+// its inode again or ialloc() runs out.
+void
+inodewrap(void)
+{
+  struct stat st;
+  uint last;
+  int i, fd, wraps;
+
+  printf(stdout, "inode wrap test\n");
+
+  last = 0;
+  wraps = 0;
+  for(i = 0; i < 1000; i++){
+    fd = open("iwrap", O_CREATE|O_RDWR);
+    if(fd < 0){
+      printf(stdout, "inodewrap: create %d failed\n", i);
+      exit();
+    }
+    if(fstat(fd, &st) < 0){
+      printf(stdout, "inodewrap: fstat failed\n");
+      exit();
+    }
+    close(fd);
+    if(unlink("iwrap") < 0){
+      printf(stdout, "inodewrap: unlink failed\n");
+      exit();
+    }
+    if(st.ino < last)
+      wraps++;
+    last = st.ino;
+  }
+  if(wraps == 0){
+    printf(stdout, "inodewrap: inode numbers never wrapped\n");
+    exit();
+  }
+  printf(stdout, "inode wrap test ok\n");
+}
+
 void dirtest(void)
 {
   printf(stdout, "mkdir test\n");
@@ -1347,7 +1402,8 @@ iref(void)
 
   printf(1, "empty file name\n");
 
-  // the 50 is NINODE
+  // the inode cache grows on demand, so 50 is arbitrary: it was
+  // the fixed cache size that a leaked reference would exhaust
   for(i = 0; i < 50 + 1; i++){
     if(mkdir("irefd") != 0){
       printf(1, "mkdir irefd failed\n");
@@ -1745,6 +1801,119 @@ rand()
   return randstate;
 }
 
+// create, write, read back and close a file through the
+// submission ring, with one ring_enter() per batch
+static struct ring ring;
+
+static void
+ringsubmit(uint op, int fd, void *addr, int len, uint user_data)
+{
+  struct ring_sqe *sqe = &ring.sq[ring.sq_tail % RING_ENTRIES];
+
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->addr = (uint)addr;
+  sqe->len = len;
+  sqe->user_data = user_data;
+  ring.sq_tail++;
+}
+
+static int
+ringreap(uint user_data)
+{
+  struct ring_cqe *cqe = &ring.cq[ring.cq_head % RING_ENTRIES];
+
+  if(ring.cq_head == ring.cq_tail || cqe->user_data != user_data){
+    printf(stdout, "ring: no completion %d\n", user_data);
+    exit();
+  }
+  ring.cq_head++;
+  return cqe->res;
+}
+
+void
+ringtest(void)
+{
+  char buf[32];
+  int fd, i;
+
+  printf(stdout, "ring test\n");
+  if(ring_setup(&ring) < 0){
+    printf(stdout, "ring_setup failed\n");
+    exit();
+  }
+
+  ringsubmit(RING_OP_OPEN, 0, "ringfile", O_CREATE|O_RDWR, 1);
+  if(ring_enter(1) != 1 || (fd = ringreap(1)) < 0){
+    printf(stdout, "ring open failed\n");
+    exit();
+  }
+
+  for(i = 0; i < 4; i++)
+    ringsubmit(RING_OP_WRITE, fd, "0123456789", 10, 2+i);
+  ringsubmit(RING_OP_FSYNC, fd, 0, 0, 6);
+  ringsubmit(RING_OP_CLOSE, fd, 0, 0, 7);
+  ringsubmit(RING_OP_OPEN, 0, "ringfile", O_RDONLY, 8);
+  if(ring_enter(RING_ENTRIES) != 7){
+    printf(stdout, "ring_enter failed\n");
+    exit();
+  }
+  for(i = 0; i < 4; i++)
+    if(ringreap(2+i) != 10){
+      printf(stdout, "ring write failed\n");
+      exit();
+    }
+  if(ringreap(6) != 0 || ringreap(7) != 0 || (fd = ringreap(8)) < 0){
+    printf(stdout, "ring fsync/close/open failed\n");
+    exit();
+  }
+
+  ringsubmit(RING_OP_READ, fd, buf, sizeof(buf), 9);
+  ringsubmit(RING_OP_CLOSE, fd, 0, 0, 10);
+  ringsubmit(RING_OP_READ, fd, buf, sizeof(buf), 11);
+  ring_enter(RING_ENTRIES);
+  if(ringreap(9) != sizeof(buf) || buf[10] != '0' || ringreap(10) != 0 ||
+     ringreap(11) != -1){
+    printf(stdout, "ring read failed\n");
+    exit();
+  }
+
+  unlink("ringfile");
+  printf(stdout, "ring test ok\n");
+}
+
+// fsync() waits for the delayed commit of a write,
+// and only applies to files
+void
+fsynctest(void)
+{
+  int fd, p[2];
+
+  printf(stdout, "fsync test\n");
+  fd = open("fsyncfile", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, "aaaaaaaaaa", 10) != 10){
+    printf(stdout, "fsync: write failed\n");
+    exit();
+  }
+  if(fsync(fd) != 0){
+    printf(stdout, "fsync failed\n");
+    exit();
+  }
+  close(fd);
+  if(fsync(fd) != -1){
+    printf(stdout, "fsync of closed fd succeeded\n");
+    exit();
+  }
+  if(pipe(p) < 0 || fsync(p[1]) != -1){
+    printf(stdout, "fsync of pipe succeeded\n");
+    exit();
+  }
+  close(p[0]);
+  close(p[1]);
+  unlink("fsyncfile");
+  printf(stdout, "fsync test ok\n");
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -1774,6 +1943,7 @@ main(int argc, char *argv[])
   writetest();
   writetest1();
   createtest();
+  inodewrap();
 
   openiputtest();
   exitiputtest();
@@ -1796,6 +1966,8 @@ main(int argc, char *argv[])
   bigdir(); // slow
 
   uio();
+  ringtest();
+  fsynctest();
 
   exectest();
 
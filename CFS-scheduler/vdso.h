@@ -0,0 +1,22 @@
+// Read-only pages the kernel maps into every process, so that
+// user space reads the clock and its pid without a system call.
+// They sit right above user memory: include memlayout.h first.
+
+#define VDSO_DATA USERTOP             // struct vdso_data, shared by all
+#define VDSO_PROC (USERTOP + 0x1000)  // struct vdso_proc, the process's own
+
+// The kernel bumps seq before and after each update, so a reader
+// retries while seq is odd or has changed.
+struct vdso_data {
+  volatile uint seq;
+  volatile uint ticks;      // as uptime()
+  volatile u64 us;          // the scheduler's clock, us
+  volatile u64 tsc;         // time stamp counter when us was set
+  volatile uint tsc_mult;   // us per TSC cycle, << VDSO_MULT_SHIFT; 0: unknown
+};
+
+#define VDSO_MULT_SHIFT 32
+
+struct vdso_proc {
+  int pid;
+};
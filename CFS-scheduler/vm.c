@@ -6,6 +6,7 @@
 #include "mmu.h"
 #include "proc.h"
 #include "elf.h"
+#include "vdso.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
@@ -21,12 +22,21 @@ seginit(void)
   // Cannot share a CODE descriptor for both kernel and user
   // because it would have to have DPL_USR, but the CPU forbids
   // an interrupt from CPL=0 to DPL=3.
-  c = &cpus[cpuid()];
+  c = findcpu();
   c->gdt[SEG_KCODE] = SEG(STA_X|STA_R, 0, 0xffffffff, 0);
   c->gdt[SEG_KDATA] = SEG(STA_W, 0, 0xffffffff, 0);
   c->gdt[SEG_UCODE] = SEG(STA_X|STA_R, 0, 0xffffffff, DPL_USER);
   c->gdt[SEG_UDATA] = SEG(STA_W, 0, 0xffffffff, DPL_USER);
+
+  // Map %gs:0 to c->self and %gs:4 to c->proc, so that mycpu()
+  // and myproc() are a single load. The kernel keeps %gs loaded;
+  // alltraps reloads it on entry from user space.
+  c->gdt[SEG_KCPU] = SEG(STA_W, &c->self, 8, 0);
   lgdt(c->gdt, sizeof(c->gdt));
+  loadgs(SEG_KCPU << 3);
+
+  c->self = c;
+  c->proc = 0;
 }
 
 // Return the address of the PTE in page table pgdir
@@ -160,7 +170,7 @@ switchuvm(struct proc *p)
     panic("switchuvm: no process");
   if(p->kstack == 0)
     panic("switchuvm: no kstack");
-  if(p->pgdir == 0)
+  if(p->pgdir == 0 && !p->kthread)
     panic("switchuvm: no pgdir");
 
   pushcli();
@@ -173,10 +183,34 @@ switchuvm(struct proc *p)
   // forbids I/O instructions (e.g., inb and outb) from user space
   mycpu()->ts.iomb = (ushort) 0xFFFF;
   ltr(SEG_TSS << 3);
-  lcr3(V2P(p->pgdir));  // switch to process's address space
+  // Kernel threads have no user memory and borrow kpgdir.
+  lcr3(V2P(p->kthread ? kpgdir : p->pgdir));
   popcli();
 }
 
+// The vDSO data page, shared by all processes.
+struct vdso_data *vdso;
+
+void
+vdsoinit(void)
+{
+  if((vdso = (struct vdso_data*)kalloc()) == 0)
+    panic("vdsoinit");
+  memset(vdso, 0, PGSIZE);
+}
+
+// Map the vDSO pages into pgdir, read-only: the shared data page
+// and vproc, the process's own page. freevm() leaves both alone.
+int
+mapvdso(pde_t *pgdir, char *vproc)
+{
+  if(mappages(pgdir, (char*)VDSO_DATA, PGSIZE, V2P(vdso), PTE_U) < 0)
+    return -1;
+  if(mappages(pgdir, (char*)VDSO_PROC, PGSIZE, V2P(vproc), PTE_U) < 0)
+    return -1;
+  return 0;
+}
+
 // Load the initcode into address 0 of pgdir.
 // sz must be less than a page.
 void
@@ -224,7 +258,7 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   char *mem;
   uint a;
 
-  if(newsz >= KERNBASE)
+  if(newsz >= USERTOP)
     return 0;
   if(newsz < oldsz)
     return oldsz;
@@ -287,7 +321,7 @@ freevm(pde_t *pgdir)
 
   if(pgdir == 0)
     panic("freevm: no pgdir");
-  deallocuvm(pgdir, KERNBASE, 0);
+  deallocuvm(pgdir, USERTOP, 0);  // the vDSO pages are not the process's
   for(i = 0; i < NPDENTRIES; i++){
     if(pgdir[i] & PTE_P){
       char * v = P2V(PTE_ADDR(pgdir[i]));
@@ -0,0 +1,99 @@
+// Workqueues: deferred work served by kernel threads.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "workqueue.h"
+
+// For work with no queue of its own.
+struct workqueue system_wq;
+
+// Take items off wq in order and run them, sleeping while empty.
+static void
+worker(void *arg)
+{
+  struct workqueue *wq = arg;
+  struct work *w;
+
+  acquire(&wq->lock);
+  for(;;){
+    while((w = wq->head) == 0){
+      wq->busy = 0;
+      wakeup(&wq->busy);  // flush_workqueue() may be waiting
+      sleep(wq, &wq->lock);
+    }
+    wq->head = w->next;
+    if(wq->head == 0)
+      wq->tail = 0;
+    w->pending = 0;
+    wq->busy = 1;
+    release(&wq->lock);
+
+    // The item may be queued again from here on.
+    w->fn(w);
+
+    acquire(&wq->lock);
+  }
+}
+
+// Set up wq and start its worker at the given nice value.
+void
+init_workqueue(struct workqueue *wq, char *name, int nice)
+{
+  initlock(&wq->lock, "workqueue");
+  wq->name = name;
+  wq->head = wq->tail = 0;
+  wq->busy = 0;
+  if((wq->pid = kthread_create(worker, wq, name, nice)) < 0)
+    panic("init_workqueue");
+}
+
+void
+init_work(struct work *w, void (*fn)(struct work*))
+{
+  w->fn = fn;
+  w->next = 0;
+  w->pending = 0;
+}
+
+// Queue w on wq to run once. Return 0 if it is already queued
+// and has not started yet, 1 otherwise.
+// Does not sleep, so it may be called holding spinlocks other
+// than ptable.lock.
+int
+queue_work(struct workqueue *wq, struct work *w)
+{
+  acquire(&wq->lock);
+  if(w->pending){
+    release(&wq->lock);
+    return 0;
+  }
+  w->pending = 1;
+  w->next = 0;
+  if(wq->tail)
+    wq->tail->next = w;
+  else
+    wq->head = w;
+  wq->tail = w;
+  wakeup(wq);
+  release(&wq->lock);
+  return 1;
+}
+
+// Wait until everything queued on wq so far has run.
+// Must not be called from wq's own worker.
+void
+flush_workqueue(struct workqueue *wq)
+{
+  acquire(&wq->lock);
+  while(wq->head || wq->busy)
+    sleep(&wq->busy, &wq->lock);
+  release(&wq->lock);
+}
+
+void
+wqinit(void)
+{
+  init_workqueue(&system_wq, "kworker", 0);
+}
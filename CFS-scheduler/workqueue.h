@@ -0,0 +1,25 @@
+// Deferred work run by kernel threads
+//
+// A workqueue is a FIFO of work items served by one kernel thread
+// of its own (see kthread_create), so work queued on it runs in
+// process context, may sleep, and is scheduled at the queue's nice
+// value instead of on the path that queued it.
+
+struct work {
+  void (*fn)(struct work*);  // Called by the worker with the item
+  struct work *next;         // Next queued item
+  int pending;               // Queued and not yet started?
+};
+
+struct workqueue {
+  struct spinlock lock;      // protects the fields below
+  struct work *head;         // FIFO of pending items
+  struct work *tail;
+  int busy;                  // Worker is running an item
+  int pid;                   // Worker thread
+
+  // For debugging:
+  char *name;
+};
+
+extern struct workqueue system_wq;
@@ -99,6 +99,34 @@ readeflags(void)
   return eflags;
 }
 
+static inline void
+readcpuid(uint info, uint *eaxp, uint *ebxp, uint *ecxp, uint *edxp)
+{
+  uint eax, ebx, ecx, edx;
+
+  asm volatile("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                       : "a" (info));
+  *eaxp = eax;
+  *ebxp = ebx;
+  *ecxp = ecx;
+  *edxp = edx;
+}
+
+static inline u64
+rdtsc(void)
+{
+  u64 tsc;
+
+  asm volatile("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+static inline void
+wrmsr(uint msr, uint lo, uint hi)
+{
+  asm volatile("wrmsr" : : "c" (msr), "a" (lo), "d" (hi));
+}
+
 static inline void
 loadgs(ushort v)
 {
@@ -130,6 +158,17 @@ xchg(volatile uint *addr, uint newval)
   return result;
 }
 
+// Atomically add v to *addr; returns the old value.
+static inline int
+xadd(volatile int *addr, int v)
+{
+  asm volatile("lock; xaddl %0, %1" :
+               "+r" (v), "+m" (*addr) :
+               :
+               "cc");
+  return v;
+}
+
 static inline uint
 rcr2(void)
 {